@@ -3,6 +3,7 @@
 
 #include <chrono>
 #include <cstdint>
+#include <cstring>
 
 #if defined(__i386__) || defined(_M_IX86) || defined(_X86_) || \
   defined(__amd64__) || defined(__x86_64__) || defined(_M_X64) || \
@@ -46,6 +47,16 @@ namespace snmalloc
      * internal high-privilege pointers for recycling memory on free().
      */
     StrictProvenance = (1 << 2),
+    /**
+     * This architecture can zero memory without first reading it into the
+     * cache, and provides `zero_streaming` to do so.
+     */
+    StreamingZero = (1 << 3),
+    /**
+     * This architecture can copy memory without reading the destination into
+     * the cache, and provides `copy_streaming` to do so.
+     */
+    StreamingCopy = (1 << 4),
   };
 
   enum AalName : int
@@ -135,6 +146,35 @@ namespace snmalloc
 #endif
       }
     }
+
+    /**
+     * Zero `size` bytes from `p` without polluting the cache, for ranges
+     * that are unlikely to be read soon in full.  This is slower than
+     * `memset` for ranges that fit comfortably in the cache.
+     *
+     * Architectures without `StreamingZero` use `memset`.
+     */
+    static inline void zero_streaming(void* p, size_t size)
+    {
+      if constexpr ((Arch::aal_features & StreamingZero) == StreamingZero)
+        Arch::zero_streaming(p, size);
+      else
+        memset(p, 0, size);
+    }
+
+    /**
+     * Copy `size` bytes from `src` to `dst` without polluting the cache with
+     * the destination, for ranges that are unlikely to be read soon in full.
+     *
+     * Architectures without `StreamingCopy` use `memcpy`.
+     */
+    static inline void copy_streaming(void* dst, const void* src, size_t size)
+    {
+      if constexpr ((Arch::aal_features & StreamingCopy) == StreamingCopy)
+        Arch::copy_streaming(dst, src, size);
+      else
+        memcpy(dst, src, size);
+    }
   };
 
 } // namespace snmalloc
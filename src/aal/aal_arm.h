@@ -13,6 +13,8 @@
 #endif
 
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 namespace snmalloc
 {
   /**
@@ -24,8 +26,12 @@ namespace snmalloc
     /**
      * Bitmap of AalFeature flags
      */
-    static constexpr uint64_t aal_features =
-      IntegerPointers | NoCpuCycleCounters;
+    static constexpr uint64_t aal_features = IntegerPointers |
+      NoCpuCycleCounters
+#if defined(__aarch64__) && !defined(_MSC_VER)
+      | StreamingZero
+#endif
+      ;
 
     static constexpr enum AalName aal_name = ARM;
 
@@ -52,6 +58,38 @@ namespace snmalloc
       __asm__ volatile("prfm pldl1keep, [%0]" : "=r"(ptr));
 #endif
     }
+
+#if defined(__aarch64__) && !defined(_MSC_VER)
+    /**
+     * Zero memory with `DC ZVA`, which zeroes a whole block without reading
+     * it.  The block size is read from `DCZID_EL0`, which also says whether
+     * the instruction may be used; if not, this uses `memset`.  The parts of
+     * the range outside whole blocks are cleared with `memset`.
+     */
+    static inline void zero_streaming(void* p, size_t size)
+    {
+      uint64_t dczid;
+      __asm__ volatile("mrs %0, dczid_el0" : "=r"(dczid));
+      uintptr_t block = uintptr_t(4) << (dczid & 0xf);
+
+      if (((dczid & 0x10) != 0) || (size < 2 * block))
+      {
+        memset(p, 0, size);
+        return;
+      }
+
+      auto* start = static_cast<char*>(p);
+      auto* end = start + size;
+      auto* q = start +
+        ((block - (reinterpret_cast<uintptr_t>(start) & (block - 1))) &
+         (block - 1));
+
+      memset(start, 0, static_cast<size_t>(q - start));
+      for (; q + block <= end; q += block)
+        __asm__ volatile("dc zva, %0" : : "r"(q) : "memory");
+      memset(q, 0, static_cast<size_t>(end - q));
+    }
+#endif
   };
 
   using AAL_Arch = AAL_arm;
@@ -19,6 +19,13 @@
 #  define SNMALLOC_VA_BITS_32
 #endif
 
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || \
+  (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define SNMALLOC_X86_SSE2
+#endif
+
+#include <cstring>
+
 namespace snmalloc
 {
   /**
@@ -58,7 +65,11 @@ namespace snmalloc
     /**
      * Bitmap of AalFeature flags
      */
-    static constexpr uint64_t aal_features = IntegerPointers;
+    static constexpr uint64_t aal_features = IntegerPointers
+#ifdef SNMALLOC_X86_SSE2
+      | StreamingZero | StreamingCopy
+#endif
+      ;
 
     static constexpr enum AalName aal_name = X86;
 
@@ -115,6 +126,86 @@ namespace snmalloc
       halt_out_of_order();
       return t;
     }
+
+#ifdef SNMALLOC_X86_SSE2
+    /**
+     * Zero memory with non-temporal stores, which write whole cache lines
+     * without reading them and without evicting other data.  The parts of
+     * the range outside whole cache lines are cleared with `memset`.
+     */
+    static inline void zero_streaming(void* p, size_t size)
+    {
+      static constexpr uintptr_t line = 64;
+      auto* start = static_cast<char*>(p);
+      auto* end = start + size;
+      auto* q = start +
+        ((line - (reinterpret_cast<uintptr_t>(start) & (line - 1))) &
+         (line - 1));
+
+      if (size < 2 * line)
+      {
+        memset(p, 0, size);
+        return;
+      }
+
+      memset(start, 0, static_cast<size_t>(q - start));
+
+      __m128i zero = _mm_setzero_si128();
+      for (; q + line <= end; q += line)
+      {
+        _mm_stream_si128(reinterpret_cast<__m128i*>(q), zero);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(q + 16), zero);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(q + 32), zero);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(q + 48), zero);
+      }
+      // Order the streaming stores before any later stores, such as those
+      // publishing the memory to another thread.
+      _mm_sfence();
+
+      memset(q, 0, static_cast<size_t>(end - q));
+    }
+
+    /**
+     * Copy memory with non-temporal stores to the destination.  The source
+     * is read normally, and the parts of the destination outside whole cache
+     * lines are written with `memcpy`.
+     */
+    static inline void copy_streaming(void* dst, const void* src, size_t size)
+    {
+      static constexpr uintptr_t line = 64;
+      auto* d = static_cast<char*>(dst);
+      auto* s = static_cast<const char*>(src);
+
+      if (size < 2 * line)
+      {
+        memcpy(dst, src, size);
+        return;
+      }
+
+      size_t head =
+        (line - (reinterpret_cast<uintptr_t>(d) & (line - 1))) & (line - 1);
+      memcpy(d, s, head);
+      d += head;
+      s += head;
+      size -= head;
+
+      for (; size >= line; size -= line, d += line, s += line)
+      {
+        auto* from = reinterpret_cast<const __m128i*>(s);
+        __m128i a = _mm_loadu_si128(from);
+        __m128i b = _mm_loadu_si128(from + 1);
+        __m128i c = _mm_loadu_si128(from + 2);
+        __m128i e = _mm_loadu_si128(from + 3);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(d), a);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(d + 16), b);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(d + 32), c);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(d + 48), e);
+      }
+      _mm_sfence();
+
+      memcpy(d, s, size);
+    }
+#endif
   };
 
   using AAL_Arch = AAL_x86;
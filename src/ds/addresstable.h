@@ -0,0 +1,162 @@
+#pragma once
+
+#include "address.h"
+#include "bits.h"
+
+#include <atomic>
+
+namespace snmalloc
+{
+  /**
+   * A fixed size open addressing hash table of `Entry`s keyed by address,
+   * used for side tables that record facts about some live allocations.
+   * Inserts and removals are lock free.
+   *
+   * `Entry` must have a `std::atomic<uintptr_t> address` field, which holds
+   * the key or one of the reserved values below.  The low `IGNORED_BITS` of
+   * the keys are assumed to carry no information and are not hashed.  An
+   * address is only looked for within `MAX_PROBE` slots of its hash, so an
+   * insert fails if those slots are all in use.
+   */
+  template<
+    typename Entry,
+    size_t SLOT_BITS,
+    size_t MAX_PROBE,
+    size_t IGNORED_BITS>
+  class AddressTable
+  {
+  public:
+    static constexpr size_t SLOTS = bits::one_at_bit(SLOT_BITS);
+
+  private:
+    /**
+     * Values of `Entry::address` that do not correspond to an allocation.
+     * `Tombstone` marks a removed entry, so that lookups continue past it,
+     * and `Busy` a slot whose entry is being written or removed.
+     */
+    static constexpr uintptr_t Empty = 0;
+    static constexpr uintptr_t Tombstone = 1;
+    static constexpr uintptr_t Busy = 2;
+
+    Entry entries[SLOTS];
+
+    static size_t slot(uintptr_t addr)
+    {
+      uint64_t h = static_cast<uint64_t>(addr >> IGNORED_BITS);
+      h *= 0x9E3779B97F4A7C15ULL;
+      return static_cast<size_t>(h >> (64 - SLOT_BITS));
+    }
+
+    /**
+     * Call `f` on the entry for `p`, which has been claimed by setting its
+     * address to `Busy`, and then remove it.
+     */
+    template<typename F>
+    static void remove_claimed(void* p, Entry& e, F f)
+    {
+      f(p, e);
+      e.address.store(Tombstone, std::memory_order_release);
+    }
+
+  public:
+    /**
+     * Add `p`, calling `fill` to initialise its entry before it becomes
+     * visible to other threads.  Returns false, without calling `fill`, if
+     * there is no free slot near the hash of `p`.
+     */
+    template<typename F>
+    bool insert(void* p, F fill)
+    {
+      uintptr_t addr = address_cast(p);
+      size_t start = slot(addr);
+
+      for (size_t i = 0; i < MAX_PROBE; i++)
+      {
+        Entry& e = entries[(start + i) & (SLOTS - 1)];
+        uintptr_t a = e.address.load(std::memory_order_relaxed);
+        if ((a != Empty) && (a != Tombstone))
+          continue;
+
+        if (!e.address.compare_exchange_strong(a, Busy))
+          continue;
+
+        fill(e);
+        e.address.store(addr, std::memory_order_release);
+        return true;
+      }
+
+      return false;
+    }
+
+    /**
+     * If `p` is present, call `f(p, entry)` and remove it.  Returns whether
+     * `p` was found.
+     */
+    template<typename F>
+    bool remove(void* p, F f)
+    {
+      uintptr_t addr = address_cast(p);
+      size_t start = slot(addr);
+
+      for (size_t i = 0; i < MAX_PROBE; i++)
+      {
+        Entry& e = entries[(start + i) & (SLOTS - 1)];
+        uintptr_t a = e.address.load(std::memory_order_acquire);
+        if (a == Empty)
+          return false;
+
+        if ((a == addr) && e.address.compare_exchange_strong(a, Busy))
+        {
+          remove_claimed(p, e, f);
+          return true;
+        }
+      }
+
+      return false;
+    }
+
+    /**
+     * Remove every entry for which `pred(p, entry)` returns true, calling
+     * `f(p, entry)` on each before it is removed.
+     */
+    template<typename P, typename F>
+    void remove_if(P pred, F f)
+    {
+      for (Entry& e : entries)
+      {
+        uintptr_t a = e.address.load(std::memory_order_acquire);
+        void* p = reinterpret_cast<void*>(a);
+        if ((a <= Busy) || !pred(p, e))
+          continue;
+
+        if (e.address.compare_exchange_strong(a, Busy))
+          remove_claimed(p, e, f);
+      }
+    }
+
+    /**
+     * Call `f(p, entry)` on every entry present.  Entries that are added or
+     * removed concurrently may or may not be visited, and an entry may be
+     * replaced while `f` reads it.
+     */
+    template<typename F>
+    void for_each(F f)
+    {
+      for (Entry& e : entries)
+      {
+        uintptr_t a = e.address.load(std::memory_order_acquire);
+        if (a > Busy)
+          f(reinterpret_cast<void*>(a), e);
+      }
+    }
+
+    /**
+     * Returns true if `p` is still the address in `e`.  Used after copying
+     * an entry visited by `for_each` to detect that it was replaced.
+     */
+    static bool still_holds(Entry& e, void* p)
+    {
+      return e.address.load(std::memory_order_acquire) == address_cast(p);
+    }
+  };
+} // namespace snmalloc
@@ -42,6 +42,11 @@ namespace snmalloc
      */
     std::atomic_flag spin_lock = ATOMIC_FLAG_INIT;
 
+    /**
+     * Total address space obtained from the platform.
+     */
+    std::atomic<size_t> reserved_bytes{0};
+
     /**
      * Checks a block satisfies its invariant.
      */
@@ -165,6 +170,28 @@ namespace snmalloc
     }
 
   public:
+    /**
+     * Returns the number of bytes of address space obtained from the
+     * platform, whether or not they have been handed out.
+     */
+    size_t reserved()
+    {
+      return reserved_bytes.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Add the `length` bytes from `base` to the address space, for memory
+     * that was obtained other than from the platform, such as a buffer
+     * supplied by the embedding application.  `base` must be pointer
+     * aligned.
+     */
+    void add_external_range(void* base, size_t length)
+    {
+      FlagLock lock(spin_lock);
+      reserved_bytes += length;
+      add_range(base, length);
+    }
+
     /**
      * Returns a pointer to a block of memory of the supplied size.
      * The block will be committed, if specified by the template parameter.
@@ -181,7 +208,12 @@ namespace snmalloc
       if constexpr (pal_supports<AlignedAllocation, PAL>)
       {
         if (size >= PAL::minimum_alloc_size)
-          return PAL::template reserve_aligned<committed>(size);
+        {
+          void* p = PAL::template reserve_aligned<committed>(size);
+          if (p != nullptr)
+            reserved_bytes += size;
+          return p;
+        }
       }
 
       void* res;
@@ -223,6 +255,7 @@ namespace snmalloc
           {
             return nullptr;
           }
+          reserved_bytes += block_size;
           add_range(block, block_size);
 
           // still holding lock so guaranteed to succeed.
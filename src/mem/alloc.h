@@ -10,6 +10,8 @@
 #include "../test/histogram.h"
 #include "allocstats.h"
 #include "chunkmap.h"
+#include "fragmentation.h"
+#include "heapprofile.h"
 #include "largealloc.h"
 #include "mediumslab.h"
 #include "pooled.h"
@@ -52,6 +54,28 @@ namespace snmalloc
     FastFreeLists() : small_fast_free_lists() {}
   };
 
+  template<class MemoryProvider, class Alloc>
+  class AllocPool;
+
+  /**
+   * The memory charged to one allocator.  See `Allocator::memory_usage`.
+   */
+  struct AllocatorMemoryUsage
+  {
+    /// Bytes of superslabs used for small allocations.
+    size_t small_bytes = 0;
+    /// Bytes of mediumslabs.
+    size_t medium_bytes = 0;
+    /// Bytes of chunks of live large allocations made by this allocator, if
+    /// it tracks them.
+    size_t large_bytes = 0;
+
+    size_t total()
+    {
+      return small_bytes + medium_bytes + large_bytes;
+    }
+  };
+
   /**
    * Allocator.  This class is parameterised on five template parameters.
    *
@@ -106,6 +130,77 @@ namespace snmalloc
      */
     void* bump_ptrs[NUM_SMALL_CLASSES] = {nullptr};
 
+    /**
+     * With `TRACK_ZERO_MEMORY`, whether the rest of the slab behind each bump
+     * pointer, and the objects on each fast free list, are known to be zero
+     * apart from the free list links stored in them.
+     */
+    bool bump_zeroed[NUM_SMALL_CLASSES] = {false};
+    bool fast_free_list_zeroed[NUM_SMALL_CLASSES] = {false};
+
+    /**
+     * Every superslab and mediumslab this allocator owns, for reporting.
+     */
+    OwnedSlabs owned_slabs;
+
+    /**
+     * Bytes of chunks charged to this allocator, by use.  These are only
+     * updated when chunks are acquired and released, and may be read by any
+     * thread through `memory_usage`.
+     */
+    std::atomic<size_t> owned_bytes[CHUNK_USES] = {};
+
+    /**
+     * Whether the large allocations this allocator makes are charged to it,
+     * so that `memory_usage` counts them and `release_all` frees them.  Set
+     * for every allocator with `TRACK_LARGE_OWNERS`, and for arenas.
+     */
+    bool track_large_owners = TRACK_LARGE_OWNERS;
+
+    /**
+     * A value chosen by the application to identify the thread or tenant
+     * using this allocator.  Reset to zero when the allocator is released to
+     * the pool.
+     */
+    std::atomic<uintptr_t> tag{0};
+
+    /**
+     * The pool this allocator was last acquired from, if any.  Used to find
+     * other allocators whose message queues need draining.
+     */
+    std::atomic<AllocPool<MemoryProvider, Allocator>*> pool{nullptr};
+
+    /**
+     * Held by a thread that is draining this allocator's message queue on its
+     * behalf, while the allocator is not owned by any thread.  A thread
+     * acquiring the allocator from the pool waits for this to be released.
+     */
+    std::atomic_flag drain_lock = ATOMIC_FLAG_INIT;
+
+    /**
+     * Set, under `drain_lock`, while another thread drains this allocator, so
+     * that remote posts made during the drain do not start a nested scan of
+     * the pool.
+     */
+    bool draining = false;
+
+    /**
+     * Number of slab allocations until this allocator next drains allocators
+     * that are not owned by a thread, and the last one it looked at.
+     */
+    size_t orphan_drain_countdown = ORPHAN_DRAIN_INTERVAL;
+    Allocator* orphan_drain_cursor = nullptr;
+
+    /**
+     * Heap profiling state: the bytes that can be allocated before the next
+     * sample (or, while sampling is disabled, before checking whether it has
+     * been enabled), the interval the countdown was drawn for, and the
+     * random number generator state used to draw it.
+     */
+    size_t heap_profile_countdown = 0;
+    size_t heap_profile_interval = 0;
+    uint64_t heap_profile_rng = 0;
+
   public:
     Stats& stats()
     {
@@ -136,6 +231,13 @@ namespace snmalloc
 #else
       constexpr sizeclass_t sizeclass = size_to_sizeclass_const(size);
 
+      if constexpr (HEAP_PROFILING)
+      {
+        if (unlikely(heap_profile_countdown <= size))
+          return alloc_profiled<zero_mem, allow_reserve>(size);
+        heap_profile_countdown -= size;
+      }
+
       stats().alloc_request(size);
 
       if constexpr (sizeclass < NUM_SMALL_CLASSES)
@@ -171,6 +273,13 @@ namespace snmalloc
       else
         return calloc(1, size);
 #else
+      if constexpr (HEAP_PROFILING)
+      {
+        if (unlikely(heap_profile_countdown <= size))
+          return alloc_profiled<zero_mem, allow_reserve>(size);
+        heap_profile_countdown -= size;
+      }
+
       // Perform the - 1 on size, so that zero wraps around and ends up on
       // slow path.
       if (likely((size - 1) <= (sizeclass_to_size(NUM_SMALL_CLASSES - 1) - 1)))
@@ -183,6 +292,89 @@ namespace snmalloc
       return alloc_not_small<zero_mem, allow_reserve>(size);
     }
 
+    /**
+     * Allocate memory aligned to `align`, a power of two known statically.
+     *
+     * Objects are aligned to the largest power of two dividing their
+     * sizeclass.  The sizeclass that a multiple of a power of two rounds up
+     * to is itself a multiple of that power of two, so rounding the size up
+     * to a multiple of `align` gives a sizeclass whose objects are aligned
+     * to `align`.
+     */
+    template<
+      size_t align,
+      ZeroMem zero_mem = NoZero,
+      AllowReserve allow_reserve = YesReserve>
+    SNMALLOC_FAST_PATH ALLOCATOR void* alloc_aligned(size_t size)
+    {
+      static_assert(
+        bits::next_pow2_const(align) == align,
+        "Alignment must be a power of two.");
+
+      // Every sizeclass is a multiple of the minimum allocation size.
+      if constexpr (align <= MIN_ALLOC_SIZE)
+        return alloc<zero_mem, allow_reserve>(size);
+      else
+        return alloc<zero_mem, allow_reserve>(
+          aligned_size(align, size == 0 ? 1 : size));
+    }
+
+    /**
+     * Allocate memory aligned to `align`, a power of two known dynamically.
+     */
+    template<ZeroMem zero_mem = NoZero, AllowReserve allow_reserve = YesReserve>
+    SNMALLOC_FAST_PATH ALLOCATOR void* alloc_aligned(size_t align, size_t size)
+    {
+      if (align <= MIN_ALLOC_SIZE)
+        return alloc<zero_mem, allow_reserve>(size);
+
+      return alloc<zero_mem, allow_reserve>(
+        aligned_size(align, size == 0 ? 1 : size));
+    }
+
+    /**
+     * Called when the heap profile countdown expires.  Performs the
+     * allocation, then samples it if profiling is enabled and draws the
+     * countdown to the next sample.
+     */
+    template<ZeroMem zero_mem = NoZero, AllowReserve allow_reserve = YesReserve>
+    SNMALLOC_SLOW_PATH ALLOCATOR void* alloc_profiled(size_t size)
+    {
+      void* p;
+      if ((size - 1) <= (sizeclass_to_size(NUM_SMALL_CLASSES - 1) - 1))
+        p = small_alloc<zero_mem, allow_reserve>(size);
+      else
+        p = alloc_not_small<zero_mem, allow_reserve>(size);
+
+      // The placeholder allocator must not be written to.  The thread's real
+      // allocator checks its own countdown on the next allocation.
+      if (NeedsInitialisation(this))
+        return p;
+
+      // Only sample if the countdown was drawn for the current interval;
+      // otherwise sampling has just been enabled or changed.
+      size_t interval = HeapProfile::interval();
+      bool sample = (interval != 0) && (interval == heap_profile_interval);
+      heap_profile_interval = interval;
+
+      if (interval == 0)
+      {
+        heap_profile_countdown = HeapProfile::RECHECK_INTERVAL;
+      }
+      else
+      {
+        if (heap_profile_rng == 0)
+          heap_profile_rng = (address_cast(this) ^ Aal::tick()) | 1;
+        heap_profile_countdown =
+          HeapProfile::next_countdown(heap_profile_rng, interval);
+      }
+
+      if (sample && (p != nullptr))
+        HeapProfile::record<typename MemoryProvider::Pal>(p, size);
+
+      return p;
+    }
+
     template<ZeroMem zero_mem = NoZero, AllowReserve allow_reserve = YesReserve>
     SNMALLOC_SLOW_PATH ALLOCATOR void* alloc_not_small(size_t size)
     {
@@ -205,6 +397,23 @@ namespace snmalloc
 #endif
     }
 
+    /**
+     * Forget `p` if the heap profiler sampled it.  This is a single branch
+     * unless some sampled object has not yet been freed.
+     */
+    static SNMALLOC_FAST_PATH void heap_profile_dealloc(void* p)
+    {
+      if constexpr (HEAP_PROFILING)
+      {
+        if (unlikely(HeapProfile::has_samples()))
+          HeapProfile::remove(p);
+      }
+      else
+      {
+        UNUSED(p);
+      }
+    }
+
     /**
      * Checks the allocation at `p` could have been validly allocated with
      * a size of `size`.
@@ -246,6 +455,7 @@ namespace snmalloc
       return free(p);
 #else
       check_size(p, size);
+      heap_profile_dealloc(p);
       constexpr sizeclass_t sizeclass = size_to_sizeclass_const(size);
 
       if (sizeclass < NUM_SMALL_CLASSES)
@@ -287,6 +497,7 @@ namespace snmalloc
 #else
       SNMALLOC_ASSERT(p != nullptr);
       check_size(p, size);
+      heap_profile_dealloc(p);
       if (likely((size - 1) <= (sizeclass_to_size(NUM_SMALL_CLASSES - 1) - 1)))
       {
         Superslab* super = Superslab::get(p);
@@ -330,6 +541,7 @@ namespace snmalloc
 #ifdef USE_MALLOC
       return free(p);
 #else
+      heap_profile_dealloc(p);
 
       uint8_t size = chunkmap().get(address_cast(p));
 
@@ -499,6 +711,291 @@ namespace snmalloc
       return id();
     }
 
+    /**
+     * Send every remote deallocation cached by this allocator to its owning
+     * allocator, without waiting for the cache budget to be exhausted, and
+     * process any messages queued for this allocator.
+     *
+     * Threads that are about to block for a long time should call this, so
+     * that memory freed on behalf of other threads is not pinned while they
+     * sleep.
+     */
+    void flush_remote()
+    {
+      // The placeholder allocator never caches anything.
+      if (NeedsInitialisation(this))
+        return;
+
+      handle_message_queue();
+
+      if (remote.has_pending())
+        post_remote();
+    }
+
+    /**
+     * With `TRACK_ZERO_MEMORY`, zero free medium objects that are not known
+     * to be zero, so that later zeroed allocations of them need not be
+     * cleared, stopping once about `max_bytes` have been written.  Returns
+     * the number of bytes zeroed.
+     *
+     * This does the work of freeing with zeroing off the allocation path.
+     * It must be called by the thread using this allocator, for example
+     * before it goes idle; calloc-heavy workloads benefit most.
+     */
+    size_t zero_free_objects(size_t max_bytes = SIZE_MAX)
+    {
+      if constexpr (!TRACK_ZERO_MEMORY)
+      {
+        UNUSED(max_bytes);
+        return 0;
+      }
+      else
+      {
+        // The placeholder allocator owns nothing.
+        if (NeedsInitialisation(this))
+          return 0;
+
+        size_t zeroed = 0;
+        owned_slabs.iterate([&](Allocslab* chunk) {
+          if (chunk->get_kind() != Medium)
+            return;
+
+          auto* slab = static_cast<Mediumslab*>(chunk);
+          if (!slab->full())
+            zeroed += slab->template zero_free<typename MemoryProvider::Pal>(
+              max_bytes - zeroed);
+        });
+        return zeroed;
+      }
+    }
+
+    /**
+     * Returns the memory currently charged to this allocator: the
+     * superslabs and mediumslabs it owns, and, if it tracks them, the large
+     * allocations it has made that have not been freed, whichever thread
+     * frees them.  This may be called from any thread.
+     */
+    AllocatorMemoryUsage memory_usage()
+    {
+      AllocatorMemoryUsage usage;
+      usage.small_bytes = owned_bytes[SmallChunk];
+      usage.medium_bytes = owned_bytes[MediumChunk];
+      usage.large_bytes = owned_bytes[LargeChunk];
+      return usage;
+    }
+
+    /**
+     * Charge the large allocations this allocator makes from now on to it,
+     * even without `TRACK_LARGE_OWNERS`.
+     */
+    void track_large_allocations()
+    {
+      track_large_owners = true;
+    }
+
+    /**
+     * Associate this allocator with the thread or tenant identified by
+     * `value`, for example by calling this on `ThreadAlloc::get()` when a
+     * thread starts work for a tenant.
+     */
+    void set_tag(uintptr_t value)
+    {
+      if (NeedsInitialisation(this))
+      {
+        InitThreadAllocator([value](void* alloc) {
+          reinterpret_cast<Allocator*>(alloc)->set_tag(value);
+          return nullptr;
+        });
+        return;
+      }
+      tag.store(value, std::memory_order_relaxed);
+    }
+
+    uintptr_t get_tag()
+    {
+      return tag.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Add the occupancy of every slab owned by this allocator to `report`.
+     * This may be called from any thread; the owning thread is only blocked
+     * if it tries to acquire or release a chunk during the walk.
+     */
+    void report_fragmentation(FragmentationReport& report)
+    {
+      owned_slabs.iterate([&](Allocslab* chunk) {
+        if (chunk->get_kind() == Super)
+          report.add_superslab(static_cast<Superslab*>(chunk), bump_ptrs);
+        else if (chunk->get_kind() == Medium)
+          report.add_mediumslab(static_cast<Mediumslab*>(chunk));
+      });
+    }
+
+    /**
+     * Free every object allocated by this allocator at once, by returning
+     * its superslabs, mediumslabs and tracked large allocations to the
+     * memory provider.  This takes time proportional to the number of
+     * chunks, not objects, and leaves the allocator ready for reuse.
+     *
+     * This is intended for allocators used as arenas, which are taken from
+     * `current_arena_pool` so that they hold no other memory, such as that
+     * of an exited thread whose objects are still in use.  The caller must
+     * ensure that no other thread is using this allocator, and that none of
+     * its objects are freed, or sitting in another allocator's remote cache,
+     * while this runs.  Threads that freed its objects must flush their
+     * remote caches first, with `flush_remote`, as a cached deallocation
+     * posted afterwards would write to memory that has been released.
+     * Objects freed later are treated as invalid frees.
+     */
+    void release_all()
+    {
+      // The placeholder allocator owns nothing.
+      if (NeedsInitialisation(this))
+        return;
+
+      // Process the whole queue, including the stub, so that messages
+      // forwarded through this allocator reach their owners.
+      {
+        Remote* p = message_queue().destroy();
+
+        while (p != nullptr)
+        {
+          Remote* n = p->non_atomic_next;
+          public_state()->remove_queued_bytes(remote_message_size(p));
+          handle_dealloc_remote(p);
+          p = n;
+        }
+      }
+
+      if (remote.has_pending())
+        post_remote();
+
+      if constexpr (HEAP_PROFILING)
+      {
+        if (HeapProfile::has_samples())
+        {
+          HeapProfile::remove_if([this](void* p) {
+            size_t kind = ChunkMap::get(address_cast(p));
+            if (kind == CMSuperslab)
+              return Superslab::get(p)->get_allocator() == public_state();
+            if (kind == CMMediumslab)
+              return Mediumslab::get(p)->get_allocator() == public_state();
+            return false;
+          });
+        }
+      }
+
+      // Empty the free lists while the slab headers they link are mapped.
+      for (size_t i = 0; i < NUM_SMALL_CLASSES; i++)
+      {
+        small_fast_free_lists[i].value = nullptr;
+        bump_ptrs[i] = nullptr;
+        while (!small_classes[i].is_empty())
+          small_classes[i].get_next()->remove();
+      }
+
+      for (auto& medium_class : medium_classes)
+        medium_class.clear();
+
+      super_available.clear();
+      super_only_short_available.clear();
+
+      owned_slabs.remove_all([this](Allocslab* chunk) {
+        if (chunk->get_kind() == Super)
+        {
+          owned_bytes[SmallChunk] -= SUPERSLAB_SIZE;
+          chunkmap().clear_slab(static_cast<Superslab*>(chunk));
+          large_allocator.dealloc(chunk, 0, SmallChunk);
+        }
+        else
+        {
+          owned_bytes[MediumChunk] -= SUPERSLAB_SIZE;
+          chunkmap().clear_slab(static_cast<Mediumslab*>(chunk));
+          release_mediumslab(static_cast<Mediumslab*>(chunk));
+          large_allocator.dealloc(chunk, 0, MediumChunk);
+        }
+        stats().superslab_push();
+      });
+
+      auto* owners = large_allocator.memory_provider.large_owner_table(false);
+      if (owners != nullptr)
+      {
+        owners->remove_all(
+          &owned_bytes[LargeChunk], [this](void* p, size_t size) {
+            if constexpr (HEAP_PROFILING)
+            {
+              if (HeapProfile::has_samples())
+                HeapProfile::remove(p);
+            }
+
+            size_t large_class = bits::next_pow2_bits(size) - SUPERSLAB_BITS;
+            chunkmap().clear_large_size(p, size);
+            stats().large_dealloc(large_class);
+
+            Largeslab* slab = static_cast<Largeslab*>(p);
+            slab->init();
+            large_allocator.dealloc(slab, large_class, LargeChunk);
+          });
+      }
+
+      // The stub message was in a superslab that has been released.
+      init_message_queue();
+    }
+
+    /**
+     * Bytes of deallocations of other allocators' objects that this
+     * allocator has cached and not yet sent.
+     */
+    size_t remote_cached_bytes()
+    {
+      int64_t cached = remote.budget - remote.capacity;
+      return cached > 0 ? static_cast<size_t>(cached) : 0;
+    }
+
+    /**
+     * Approximate number of bytes of deallocations that other threads have
+     * sent to this allocator, which it has not yet processed.
+     */
+    size_t remote_queued_bytes()
+    {
+      return public_state()->queued_bytes.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * A measure of how much this allocator can serve without fetching new
+     * slabs: the number of sizeclasses with a warm free list, a partially
+     * used slab, or a bump allocator within a slab, and whether it has
+     * superslabs with free slabs.  Used by the pool to choose which released
+     * allocator to hand out.
+     */
+    size_t reuse_score()
+    {
+      size_t score = 0;
+
+      for (size_t i = 0; i < NUM_SMALL_CLASSES; i++)
+      {
+        if (small_fast_free_lists[i].value != nullptr)
+          score++;
+        if (!small_classes[i].is_empty())
+          score++;
+        if (pointer_align_up(bump_ptrs[i], SLAB_SIZE) != bump_ptrs[i])
+          score++;
+      }
+
+      for (auto& medium_class : medium_classes)
+      {
+        if (!medium_class.is_empty())
+          score++;
+      }
+
+      if (!super_available.is_empty())
+        score++;
+      if (!super_only_short_available.is_empty())
+        score++;
+
+      return score;
+    }
+
   private:
     using alloc_id_t = typename Remote::alloc_id_t;
 
@@ -518,9 +1015,13 @@ namespace snmalloc
 
       Remote* last{&head};
 
+      /// The number of bytes of deallocations in this list.
+      size_t bytes = 0;
+
       void clear()
       {
         last = &head;
+        bytes = 0;
       }
 
       bool empty()
@@ -529,6 +1030,38 @@ namespace snmalloc
       }
     };
 
+    /**
+     * Returns true if remote deallocations of this sizeclass are pre-linked
+     * into runs.  The object must be large enough to hold a `RemoteChain`
+     * header.  The sender and the receiver must agree on this.
+     */
+    static constexpr bool is_remote_chain_sizeclass(sizeclass_t sizeclass)
+    {
+      return REMOTE_CHAINS && (sizeclass < NUM_SMALL_CLASSES) &&
+        (sizeclass_to_size(sizeclass) >= sizeof(RemoteChain));
+    }
+
+    /**
+     * The number of bytes of deallocations carried by a remote message.
+     */
+    static size_t remote_message_size(Remote* r)
+    {
+      Superslab* super = Superslab::get(r);
+      if (super->get_kind() == Medium)
+        return sizeclass_to_size(Mediumslab::get(r)->get_sizeclass());
+
+      sizeclass_t sizeclass = super->get_meta(Metaslab::get_slab(r)).sizeclass;
+      size_t size = sizeclass_to_size(sizeclass);
+
+      if constexpr (REMOTE_CHAINS)
+      {
+        if (is_remote_chain_sizeclass(sizeclass))
+          size *= static_cast<RemoteChain*>(r)->chain_length;
+      }
+
+      return size;
+    }
+
     struct RemoteCache
     {
       /**
@@ -540,8 +1073,23 @@ namespace snmalloc
        * and lazily provide a real allocator.
        */
       int64_t capacity{0};
+
+      /**
+       * The value `capacity` was last reset to, so that `capacity < budget`
+       * if, and only if, deallocations are cached.
+       */
+      int64_t budget{0};
+
       std::array<RemoteList, REMOTE_SLOTS> list{};
 
+      /**
+       * Returns true if there are cached deallocations waiting to be posted.
+       */
+      bool has_pending()
+      {
+        return capacity < budget;
+      }
+
       /// Used to find the index into the array of queues for remote
       /// deallocation
       /// r is used for which round of sending this is.
@@ -559,12 +1107,21 @@ namespace snmalloc
         return (id >> (initial_shift + (r * REMOTE_SLOT_BITS))) & REMOTE_MASK;
       }
 
-      SNMALLOC_FAST_PATH void
-      dealloc_sized(alloc_id_t target_id, void* p, size_t objectsize)
+      /**
+       * Runs of remote deallocations to a single slab that are still being
+       * built.  Indexed by the address of the slab, and only present when
+       * `REMOTE_CHAINS` is enabled.
+       */
+      std::array<RemoteChain*, REMOTE_CHAIN_SLOTS> open_chains{};
+
+      /// Used to find the index into the array of open chains for an object.
+      static size_t get_chain_slot(void* p)
       {
-        this->capacity -= objectsize;
+        return (address_cast(p) >> SLAB_BITS) & (REMOTE_CHAIN_SLOTS - 1);
+      }
 
-        Remote* r = static_cast<Remote*>(p);
+      SNMALLOC_FAST_PATH void append(alloc_id_t target_id, Remote* r)
+      {
         r->set_target_id(target_id);
         SNMALLOC_ASSERT(r->target_id() == target_id);
 
@@ -573,17 +1130,109 @@ namespace snmalloc
         l->last = r;
       }
 
+      SNMALLOC_FAST_PATH void
+      dealloc_sized(alloc_id_t target_id, void* p, size_t objectsize)
+      {
+        this->capacity -= objectsize;
+        list[get_slot(target_id, 0)].bytes += objectsize;
+        append(target_id, static_cast<Remote*>(p));
+      }
+
+      /**
+       * Add an object to the run of objects being returned to the same slab.
+       * If the slot holds a run for a different slab, that run is closed and
+       * queued for its target first.
+       */
+      SNMALLOC_FAST_PATH void
+      dealloc_chained(alloc_id_t target_id, void* p, size_t objectsize)
+      {
+        this->capacity -= objectsize;
+        list[get_slot(target_id, 0)].bytes += objectsize;
+
+        RemoteChain*& open = open_chains[get_chain_slot(p)];
+        RemoteChain* c = open;
+        if (likely(
+              (c != nullptr) &&
+              (Metaslab::get_slab(c) == Metaslab::get_slab(p))))
+        {
+          Metaslab::store_next(p, c->chain_head);
+          c->chain_head = p;
+          c->chain_length++;
+          return;
+        }
+
+        if (c != nullptr)
+          append(c->target_id(), c);
+
+        c = static_cast<RemoteChain*>(p);
+        c->set_target_id(target_id);
+        c->chain_head = p;
+        c->chain_length = 1;
+        open = c;
+      }
+
       SNMALLOC_FAST_PATH void
       dealloc(alloc_id_t target_id, void* p, sizeclass_t sizeclass)
       {
+        if constexpr (REMOTE_CHAINS)
+        {
+          if (is_remote_chain_sizeclass(sizeclass))
+          {
+            dealloc_chained(target_id, p, sizeclass_to_size(sizeclass));
+            return;
+          }
+        }
+
         dealloc_sized(target_id, p, sizeclass_to_size(sizeclass));
       }
 
-      void post(alloc_id_t id)
+      /**
+       * Queue a message that arrived at the wrong allocator for its target.
+       * Runs are forwarded whole, rather than being split back into objects.
+       */
+      SNMALLOC_FAST_PATH void
+      forward(alloc_id_t target_id, Remote* r, sizeclass_t sizeclass)
+      {
+        size_t length = 1;
+
+        if constexpr (REMOTE_CHAINS)
+        {
+          if (is_remote_chain_sizeclass(sizeclass))
+            length = static_cast<RemoteChain*>(r)->chain_length;
+        }
+
+        dealloc_sized(target_id, r, sizeclass_to_size(sizeclass) * length);
+      }
+
+      /**
+       * Queue every run that is still being built for its target.
+       */
+      void close_chains()
+      {
+        for (auto& c : open_chains)
+        {
+          if (c != nullptr)
+          {
+            append(c->target_id(), c);
+            c = nullptr;
+          }
+        }
+      }
+
+      /**
+       * Send all cached deallocations to their target allocators.  Returns
+       * true if this takes any target's message queue over
+       * `REMOTE_QUEUE_THRESHOLD`.
+       */
+      bool post(alloc_id_t id)
       {
         // When the cache gets big, post lists to their target allocators.
-        capacity = REMOTE_CACHE;
+        budget = remote_cache_budget.load(std::memory_order_relaxed);
+        capacity = budget;
+
+        close_chains();
 
+        bool over_threshold = false;
         size_t post_round = 0;
 
         while (true)
@@ -602,14 +1251,16 @@ namespace snmalloc
             {
               // Send all slots to the target at the head of the list.
               Superslab* super = Superslab::get(first);
-              super->get_allocator()->message_queue.enqueue(first, l->last);
+              RemoteAllocator* target = super->get_allocator();
+              over_threshold |= target->add_queued_bytes(l->bytes);
+              target->message_queue.enqueue(first, l->last);
               l->clear();
             }
           }
 
           RemoteList* resend = &list[my_slot];
           if (resend->empty())
-            break;
+            return over_threshold;
 
           // Entries could map back onto the "resend" list,
           // so take copy of the head, mark the last element,
@@ -628,6 +1279,7 @@ namespace snmalloc
             RemoteList* l = &list[slot];
             l->last->non_atomic_next = r;
             l->last = r;
+            l->bytes += remote_message_size(r);
 
             r = r->non_atomic_next;
           }
@@ -647,6 +1299,10 @@ namespace snmalloc
       remote_alloc;
 
 #ifdef CACHE_FRIENDLY_OFFSET
+    static_assert(
+      !REMOTE_CHAINS,
+      "Remote chains store their header at the start of each object.");
+
     size_t remote_offset = 0;
 
     void* apply_cache_friendly_offset(void* p, sizeclass_t sizeclass)
@@ -763,11 +1419,38 @@ namespace snmalloc
         while (p != nullptr)
         {
           Remote* n = p->non_atomic_next;
+          public_state()->remove_queued_bytes(remote_message_size(p));
           handle_dealloc_remote(p);
           p = n;
         }
       }
 
+      flush_local_caches();
+
+      for (size_t i = 0; i < NUM_SMALL_CLASSES; i++)
+      {
+        test(small_classes[i]);
+      }
+
+      for (auto& medium_class : medium_classes)
+      {
+        test(medium_class);
+      }
+
+      test(super_available);
+      test(super_only_short_available);
+
+      // Place the static stub message on the queue.
+      init_message_queue();
+    }
+
+    /**
+     * Return the free objects held in the bump allocators and fast free
+     * lists to their slabs.  Slabs, and then superslabs, that become entirely
+     * free are returned to the memory provider.
+     */
+    void flush_local_caches()
+    {
       // Dump bump allocators back into memory
       for (size_t i = 0; i < NUM_SMALL_CLASSES; i++)
       {
@@ -801,20 +1484,44 @@ namespace snmalloc
 
           prev = n;
         }
-
-        test(small_classes[i]);
       }
+    }
 
-      for (auto& medium_class : medium_classes)
+    /**
+     * Called by another thread that has taken over this allocator while no
+     * thread owns it.  Processes the whole message queue and flushes the
+     * local caches, so that memory freed to this allocator after its thread
+     * exited is returned to the memory provider.
+     */
+    void drain_orphan()
+    {
+      while (has_messages())
+        handle_message_queue_inner();
+
+      flush_local_caches();
+
+      // Forward anything that was not for this allocator, but do not start a
+      // scan of the pool from within one.
+      if (remote.has_pending())
       {
-        test(medium_class);
+        stats().remote_post();
+        remote.post(id());
       }
+    }
 
-      test(super_available);
-      test(super_only_short_available);
+    /**
+     * Amortised check, called on slow paths that fetch new slabs, that
+     * periodically drains allocators that are not owned by any thread.
+     */
+    void maybe_drain_orphans()
+    {
+      if (likely(--orphan_drain_countdown > 0))
+        return;
 
-      // Place the static stub message on the queue.
-      init_message_queue();
+      orphan_drain_countdown = ORPHAN_DRAIN_INTERVAL;
+      auto* p = pool.load(std::memory_order_acquire);
+      if (p != nullptr)
+        p->drain_orphans(this);
     }
 
     template<Boundary location>
@@ -848,6 +1555,8 @@ namespace snmalloc
         error("Critical error: Out-of-memory during initialisation.");
       }
       dummy->set_target_id(id());
+      // The stub is processed as a message when it is replaced.
+      public_state()->add_queued_bytes(MIN_ALLOC_SIZE);
       message_queue().init(dummy);
     }
 
@@ -865,6 +1574,16 @@ namespace snmalloc
         Metaslab& meta = super->get_meta(slab);
         if (likely(p->target_id() == id()))
         {
+          if constexpr (REMOTE_CHAINS)
+          {
+            if (is_remote_chain_sizeclass(meta.sizeclass))
+            {
+              handle_dealloc_remote_chain(
+                super, static_cast<RemoteChain*>(p), meta.sizeclass);
+              return;
+            }
+          }
+          stats().remote_receive(meta.sizeclass);
           small_dealloc_offseted(super, p, meta.sizeclass);
           return;
         }
@@ -872,6 +1591,35 @@ namespace snmalloc
       handle_dealloc_remote_slow(p);
     }
 
+    /**
+     * Return a run of objects pre-linked by the sender.  If the slab does not
+     * change status, then the run is spliced onto the slab's free list
+     * without visiting the objects.  Otherwise they are returned one at a
+     * time, so that the slab status is updated correctly.
+     */
+    SNMALLOC_FAST_PATH void handle_dealloc_remote_chain(
+      Superslab* super, RemoteChain* c, sizeclass_t sizeclass)
+    {
+      size_t length = c->chain_length;
+      void* head = c->chain_head;
+      stats().remote_chain_receive(sizeclass, length);
+
+      Slab* slab = Metaslab::get_slab(c);
+      if (likely(slab->dealloc_chain_fast(super, head, c, length)))
+        return;
+
+      // The header is the tail of the run and does not yet have a valid
+      // free list next pointer, so stop following the run before it.
+      for (size_t i = 1; i < length; i++)
+      {
+        void* n = Metaslab::follow_next(head);
+        small_dealloc_offseted_inner(super, head, sizeclass);
+        head = n;
+      }
+      SNMALLOC_ASSERT(head == c);
+      small_dealloc_offseted_inner(super, c, sizeclass);
+    }
+
     SNMALLOC_SLOW_PATH void handle_dealloc_remote_slow(Remote* p)
     {
       Superslab* super = Superslab::get(p);
@@ -882,12 +1630,13 @@ namespace snmalloc
         {
           sizeclass_t sizeclass = slab->get_sizeclass();
           void* start = remove_cache_friendly_offset(p, sizeclass);
+          stats().remote_receive(sizeclass);
           medium_dealloc(slab, start, sizeclass);
         }
         else
         {
           // Queue for remote dealloc elsewhere.
-          remote.dealloc(p->target_id(), p, slab->get_sizeclass());
+          remote.forward(p->target_id(), p, slab->get_sizeclass());
         }
       }
       else
@@ -896,12 +1645,15 @@ namespace snmalloc
         Slab* slab = Metaslab::get_slab(p);
         Metaslab& meta = super->get_meta(slab);
         // Queue for remote dealloc elsewhere.
-        remote.dealloc(p->target_id(), p, meta.sizeclass);
+        remote.forward(p->target_id(), p, meta.sizeclass);
       }
     }
 
     SNMALLOC_SLOW_PATH void handle_message_queue_inner()
     {
+      TickTimer timer(stats().message_queue_latency);
+      size_t bytes = 0;
+
       for (size_t i = 0; i < REMOTE_BATCH; i++)
       {
         auto r = message_queue().dequeue();
@@ -909,15 +1661,33 @@ namespace snmalloc
         if (unlikely(!r.second))
           break;
 
+        bytes += remote_message_size(r.first);
         handle_dealloc_remote(r.first);
       }
 
+      public_state()->remove_queued_bytes(bytes);
+
       // Our remote queues may be larger due to forwarding remote frees.
       if (likely(remote.capacity > 0))
         return;
 
+      post_remote();
+    }
+
+    /**
+     * Send the remote cache to the target allocators.  If this leaves any
+     * of them with too much queued, ask the pool to drain the message queues
+     * of allocators that are not owned by a thread.
+     */
+    void post_remote()
+    {
       stats().remote_post();
-      remote.post(id());
+      if (unlikely(remote.post(id())) && !draining)
+      {
+        auto* p = pool.load(std::memory_order_acquire);
+        if (p != nullptr)
+          p->drain_overloaded();
+      }
     }
 
     /**
@@ -948,13 +1718,15 @@ namespace snmalloc
 
       super = reinterpret_cast<Superslab*>(
         large_allocator.template alloc<NoZero, allow_reserve>(
-          0, SUPERSLAB_SIZE));
+          0, SUPERSLAB_SIZE, SmallChunk));
 
       if (super == nullptr)
         return super;
 
       super->init(public_state());
       chunkmap().set_slab(super);
+      owned_slabs.insert(super);
+      owned_bytes[SmallChunk] += SUPERSLAB_SIZE;
       super_available.insert(super);
       return super;
     }
@@ -994,9 +1766,14 @@ namespace snmalloc
     }
 
     template<AllowReserve allow_reserve>
-    SNMALLOC_SLOW_PATH Slab* alloc_slab(sizeclass_t sizeclass)
+    SNMALLOC_SLOW_PATH Slab* alloc_slab(sizeclass_t sizeclass, bool& zeroed)
     {
       stats().sizeclass_alloc_slab(sizeclass);
+      maybe_drain_orphans();
+
+      // Time only the slab allocation, not draining other allocators.
+      TickTimer timer(stats().alloc_slab_latency);
+
       if (Superslab::is_short_sizeclass(sizeclass))
       {
         // Pull a short slab from the list of superslabs that have only the
@@ -1005,7 +1782,7 @@ namespace snmalloc
 
         if (super != nullptr)
         {
-          Slab* slab = super->alloc_short_slab(sizeclass);
+          Slab* slab = super->alloc_short_slab(sizeclass, zeroed);
           SNMALLOC_ASSERT(super->is_full());
           return slab;
         }
@@ -1015,7 +1792,7 @@ namespace snmalloc
         if (super == nullptr)
           return nullptr;
 
-        Slab* slab = super->alloc_short_slab(sizeclass);
+        Slab* slab = super->alloc_short_slab(sizeclass, zeroed);
         reposition_superslab(super);
         return slab;
       }
@@ -1025,7 +1802,7 @@ namespace snmalloc
       if (super == nullptr)
         return nullptr;
 
-      Slab* slab = super->alloc_slab(sizeclass);
+      Slab* slab = super->alloc_slab(sizeclass, zeroed);
       reposition_superslab(super);
       return slab;
     }
@@ -1063,7 +1840,8 @@ namespace snmalloc
         void* p = remove_cache_friendly_offset(head, sizeclass);
         if constexpr (zero_mem == YesZero)
         {
-          MemoryProvider::Pal::zero(p, sizeclass_to_size(sizeclass));
+          zero_small_object(
+            p, head, sizeclass, fast_free_list_zeroed[sizeclass]);
         }
         return p;
       }
@@ -1108,7 +1886,12 @@ namespace snmalloc
 
         SlabLink* link = sl.get_next();
         slab = get_slab(link);
+        Metaslab& meta = slab->get_meta();
+        stats().sizeclass_refill(
+          sizeclass, static_cast<size_t>(meta.allocated - meta.needed));
         auto& ffl = small_fast_free_lists[sizeclass];
+        if constexpr (TRACK_ZERO_MEMORY)
+          fast_free_list_zeroed[sizeclass] = false;
         return slab->alloc<zero_mem, typename MemoryProvider::Pal>(
           sl, ffl, rsize);
       }
@@ -1175,18 +1958,36 @@ namespace snmalloc
       auto rsize = sizeclass_to_size(sizeclass);
       auto& ffl = small_fast_free_lists[sizeclass];
       SNMALLOC_ASSERT(ffl.value == nullptr);
-      Slab::alloc_new_list(bp, ffl, rsize);
+      stats().sizeclass_refill(
+        sizeclass, Slab::alloc_new_list(bp, ffl, rsize));
+
+      if constexpr (TRACK_ZERO_MEMORY)
+        fast_free_list_zeroed[sizeclass] = bump_zeroed[sizeclass];
 
       void* p = remove_cache_friendly_offset(ffl.value, sizeclass);
       ffl.value = Metaslab::follow_next(p);
 
       if constexpr (zero_mem == YesZero)
       {
-        MemoryProvider::Pal::zero(p, sizeclass_to_size(sizeclass));
+        zero_small_object(p, p, sizeclass, fast_free_list_zeroed[sizeclass]);
       }
       return p;
     }
 
+    /**
+     * Zero the small object `p`, taken from a free list whose link was at
+     * `node`.  If the object is known to be zero apart from the link, only
+     * the link is cleared.
+     */
+    SNMALLOC_FAST_PATH void
+    zero_small_object(void* p, void* node, sizeclass_t sizeclass, bool zeroed)
+    {
+      if (TRACK_ZERO_MEMORY && zeroed)
+        Metaslab::clear_next(node);
+      else
+        MemoryProvider::Pal::zero(p, sizeclass_to_size(sizeclass));
+    }
+
     /**
      * Allocates a new slab to allocate from, set it to be the bump allocator
      * for this size class, and then builds a new free list from the thread
@@ -1197,11 +1998,14 @@ namespace snmalloc
     {
       auto& bp = bump_ptrs[sizeclass];
       // Fetch new slab
-      Slab* slab = alloc_slab<allow_reserve>(sizeclass);
+      bool zeroed;
+      Slab* slab = alloc_slab<allow_reserve>(sizeclass, zeroed);
       if (slab == nullptr)
         return nullptr;
       bp =
         pointer_offset(slab, get_initial_offset(sizeclass, slab->is_short()));
+      if constexpr (TRACK_ZERO_MEMORY)
+        bump_zeroed[sizeclass] = zeroed;
 
       return small_alloc_build_free_list<zero_mem, allow_reserve>(sizeclass);
     }
@@ -1285,9 +2089,11 @@ namespace snmalloc
         case Superslab::Empty:
         {
           super_available.remove(super);
+          owned_slabs.remove(super);
+          owned_bytes[SmallChunk] -= SUPERSLAB_SIZE;
 
           chunkmap().clear_slab(super);
-          large_allocator.dealloc(super, 0);
+          large_allocator.dealloc(super, 0, SmallChunk);
           stats().superslab_push();
           break;
         }
@@ -1313,7 +2119,7 @@ namespace snmalloc
 
       if (slab != nullptr)
       {
-        p = slab->alloc<zero_mem, typename MemoryProvider::Pal>(size);
+        p = slab->alloc<zero_mem>(size, large_allocator.memory_provider);
 
         if (slab->full())
           sc->pop();
@@ -1327,16 +2133,20 @@ namespace snmalloc
               ->medium_alloc<zero_mem, allow_reserve>(sizeclass, rsize, size);
           });
         }
+        maybe_drain_orphans();
         slab = reinterpret_cast<Mediumslab*>(
           large_allocator.template alloc<NoZero, allow_reserve>(
-            0, SUPERSLAB_SIZE));
+            0, SUPERSLAB_SIZE, MediumChunk));
 
         if (slab == nullptr)
           return nullptr;
 
-        slab->init(public_state(), sizeclass, rsize);
+        slab->init(public_state(), sizeclass);
         chunkmap().set_slab(slab);
-        p = slab->alloc<zero_mem, typename MemoryProvider::Pal>(size);
+        owned_slabs.insert(slab);
+        owned_bytes[MediumChunk] += SUPERSLAB_SIZE;
+        stats().sizeclass_alloc_slab(sizeclass);
+        p = slab->alloc<zero_mem>(size, large_allocator.memory_provider);
 
         if (!slab->full())
           sc->insert(slab);
@@ -1371,15 +2181,54 @@ namespace snmalloc
           sc->remove(slab);
         }
 
+        owned_slabs.remove(slab);
+        owned_bytes[MediumChunk] -= SUPERSLAB_SIZE;
         chunkmap().clear_slab(slab);
-        large_allocator.dealloc(slab, 0);
+        release_mediumslab(slab);
+        large_allocator.dealloc(slab, 0, MediumChunk);
+        stats().sizeclass_dealloc_slab(sizeclass);
         stats().superslab_push();
       }
-      else if (was_full)
+      else
       {
-        sizeclass_t medium_class = sizeclass - NUM_SMALL_CLASSES;
-        DLList<Mediumslab>* sc = &medium_classes[medium_class];
-        sc->insert(slab);
+        if constexpr (MEDIUM_DECOMMIT_THRESHOLD != 0)
+        {
+          if (
+            (sizeclass_to_size(sizeclass) >= MEDIUM_DECOMMIT_THRESHOLD) &&
+            (large_allocator.memory_provider.decommit_policy.load(
+               std::memory_order_relaxed) != DecommitNone))
+          {
+            slab->decommit(p, large_allocator.memory_provider);
+          }
+        }
+
+        if (was_full)
+        {
+          sizeclass_t medium_class = sizeclass - NUM_SMALL_CLASSES;
+          DLList<Mediumslab>* sc = &medium_classes[medium_class];
+          sc->insert(slab);
+        }
+      }
+    }
+
+    /**
+     * Called before a mediumslab is returned to the large allocator.  Chunks
+     * are expected to be committed unless it decommits them itself, so the
+     * interiors of decommitted objects are otherwise recommitted.
+     */
+    void release_mediumslab(Mediumslab* slab)
+    {
+      if constexpr (MEDIUM_DECOMMIT_THRESHOLD != 0)
+      {
+        auto& provider = large_allocator.memory_provider;
+        slab->release_decommitted(
+          provider,
+          provider.decommit_policy.load(std::memory_order_relaxed) !=
+            DecommitSuper);
+      }
+      else
+      {
+        UNUSED(slab);
       }
     }
 
@@ -1402,16 +2251,38 @@ namespace snmalloc
         });
       }
 
+      TickTimer timer(stats().large_alloc_latency);
       size_t size_bits = bits::next_pow2_bits(size);
       size_t large_class = size_bits - SUPERSLAB_BITS;
       SNMALLOC_ASSERT(large_class < NUM_LARGE_CLASSES);
 
       void* p = large_allocator.template alloc<zero_mem, allow_reserve>(
-        large_class, size);
+        large_class, size, LargeChunk);
       if (likely(p != nullptr))
       {
-        chunkmap().set_large_size(p, size);
+        if (track_large_owners)
+        {
+          // Every live large allocation is charged to this allocator, so
+          // return the chunk and fail the allocation if there is no memory
+          // to record it.
+          auto& provider = large_allocator.memory_provider;
+          auto* owners = provider.large_owner_table();
+          if (unlikely(
+                (owners == nullptr) ||
+                !owners->insert(
+                  provider,
+                  p,
+                  &owned_bytes[LargeChunk],
+                  bits::one_at_bit(size_bits))))
+          {
+            Largeslab* slab = static_cast<Largeslab*>(p);
+            slab->init();
+            large_allocator.dealloc(slab, large_class, LargeChunk);
+            return nullptr;
+          }
+        }
 
+        chunkmap().set_large_size(p, size);
         stats().alloc_request(size);
         stats().large_alloc(large_class);
       }
@@ -1437,12 +2308,18 @@ namespace snmalloc
 
       chunkmap().clear_large_size(p, size);
 
+      // Credit the allocator that made this allocation, if it was charged.
+      // The table only exists once some allocator tracks large allocations.
+      auto* owners = large_allocator.memory_provider.large_owner_table(false);
+      if (owners != nullptr)
+        owners->remove(p);
+
       stats().large_dealloc(large_class);
 
       // Initialise in order to set the correct SlabKind.
       Largeslab* slab = static_cast<Largeslab*>(p);
       slab->init();
-      large_allocator.dealloc(slab, large_class);
+      large_allocator.dealloc(slab, large_class, LargeChunk);
     }
 
     // This is still considered the fast path as all the complex code is tail
@@ -1457,12 +2334,11 @@ namespace snmalloc
       // Check whether this will overflow the cache first.  If we are a fake
       // allocator, then our cache will always be full and so we will never hit
       // this path.
-      size_t sz = sizeclass_to_size(sizeclass);
       if (remote.capacity > 0)
       {
         void* offseted = apply_cache_friendly_offset(p, sizeclass);
         stats().remote_free(sizeclass);
-        remote.dealloc_sized(target->id(), offseted, sz);
+        remote.dealloc(target->id(), offseted, sizeclass);
         return;
       }
 
@@ -1492,8 +2368,7 @@ namespace snmalloc
       void* offseted = apply_cache_friendly_offset(p, sizeclass);
       remote.dealloc(target->id(), offseted, sizeclass);
 
-      stats().remote_post();
-      remote.post(id());
+      post_remote();
     }
 
     ChunkMap& chunkmap()
@@ -39,6 +39,115 @@ namespace snmalloc
 #endif
     ;
 
+  // Allocators that are not owned by any thread have their message queues
+  // drained by other threads once this many bytes of deallocations are
+  // waiting in them.
+  static constexpr size_t REMOTE_QUEUE_THRESHOLD =
+#ifdef USE_REMOTE_QUEUE_THRESHOLD
+    USE_REMOTE_QUEUE_THRESHOLD
+#else
+    1 << 24
+#endif
+    ;
+
+  // Every this many slab allocations, an allocator drains the message queues
+  // of up to ORPHAN_DRAIN_BATCH allocators that are not owned by any thread,
+  // so that memory freed to exited threads is returned.
+  static constexpr size_t ORPHAN_DRAIN_INTERVAL =
+#ifdef USE_ORPHAN_DRAIN_INTERVAL
+    USE_ORPHAN_DRAIN_INTERVAL
+#else
+    64
+#endif
+    ;
+  static constexpr size_t ORPHAN_DRAIN_BATCH = 4;
+
+  // Pre-link remote deallocations to the same slab on the sending side, so
+  // the receiving allocator can splice them into the slab's free list in one
+  // step rather than returning them one object at a time.
+  static constexpr bool REMOTE_CHAINS =
+#ifdef USE_REMOTE_CHAINS
+    true
+#else
+    false
+#endif
+    ;
+
+  // Compile in the sampling heap profiler.  Sampling is still off until an
+  // interval is set at runtime, or with USE_HEAP_PROFILE_INTERVAL.
+  static constexpr bool HEAP_PROFILING =
+#ifdef USE_HEAP_PROFILING
+    true
+#else
+    false
+#endif
+    ;
+
+  // Charge every large allocation to the allocator that made it, for
+  // `Allocator::memory_usage`, whichever thread frees it.  This records
+  // each one in a shared hash table; arenas track their own regardless.
+  static constexpr bool TRACK_LARGE_OWNERS =
+#ifdef USE_LARGE_OWNER_TRACKING
+    true
+#else
+    false
+#endif
+    ;
+
+  // Mean number of bytes allocated between heap profile samples, or zero to
+  // start with sampling disabled.
+  static constexpr size_t HEAP_PROFILE_INTERVAL =
+#ifdef USE_HEAP_PROFILE_INTERVAL
+    USE_HEAP_PROFILE_INTERVAL
+#else
+    0
+#endif
+    ;
+
+  // Track which free medium objects, and which fresh small objects, are
+  // known to be zero, so that zeroed allocations can skip clearing them.
+  static constexpr bool TRACK_ZERO_MEMORY =
+#ifdef USE_ZERO_TRACKING
+    true
+#else
+    false
+#endif
+    ;
+
+  // Objects of sizeclasses smaller than this are handed out from new free
+  // lists at least this many bytes apart, so that objects allocated one after
+  // another, which may be used by different threads, do not share a cache
+  // line.  Zero hands them out in address order.
+  static constexpr size_t FREE_LIST_SPREAD =
+#ifdef USE_FREE_LIST_SPREAD
+    USE_FREE_LIST_SPREAD
+#else
+    0
+#endif
+    ;
+
+  // Sizes up to this many bytes, or up to the slab size if it is larger,
+  // are mapped to a sizeclass with a single table lookup, in a table with an
+  // entry for every MIN_ALLOC_SIZE bytes.  Zero covers the small sizes only,
+  // with an entry for every pointer size.
+  static constexpr size_t SIZECLASS_LOOKUP_LIMIT =
+#ifdef USE_SIZECLASS_LOOKUP_LIMIT
+    USE_SIZECLASS_LOOKUP_LIMIT
+#else
+    0
+#endif
+    ;
+
+  // At most this many small sizeclasses are added to tune the sizeclass
+  // ladder for the profile named by SNMALLOC_SIZECLASS_PROFILE.
+  static constexpr size_t MAX_PROFILE_SIZECLASSES =
+#ifdef USE_MAX_PROFILE_SIZECLASSES
+    USE_MAX_PROFILE_SIZECLASSES
+#else
+    8
+#endif
+    ;
+
   // Specifies smaller slab and super slab sizes for address space
   // constrained scenarios.
   static constexpr size_t USE_LARGE_CHUNKS =
@@ -86,6 +195,19 @@ namespace snmalloc
 #endif
     ;
 
+  // Free medium objects of at least this many bytes have the pages that they
+  // do not share with other objects decommitted until they are reused, so
+  // that partially used mediumslabs do not keep them resident.  Zero, the
+  // default, disables this.  It is never done while the memory provider's
+  // decommit policy is DecommitNone.
+  static constexpr size_t MEDIUM_DECOMMIT_THRESHOLD =
+#ifdef USE_MEDIUM_DECOMMIT_THRESHOLD
+    USE_MEDIUM_DECOMMIT_THRESHOLD
+#else
+    0
+#endif
+    ;
+
   // The remaining values are derived, not configurable.
   static constexpr size_t POINTER_BITS =
     bits::next_pow2_bits_const(sizeof(uintptr_t));
@@ -123,6 +245,15 @@ namespace snmalloc
   static constexpr size_t REMOTE_SLOTS = 1 << REMOTE_SLOT_BITS;
   static constexpr size_t REMOTE_MASK = REMOTE_SLOTS - 1;
 
+  // Number of runs of remote deallocations that are built at the same time,
+  // when REMOTE_CHAINS is enabled.  Runs are indexed by slab address.
+  static constexpr size_t REMOTE_CHAIN_SLOT_BITS = 4;
+  static constexpr size_t REMOTE_CHAIN_SLOTS =
+    REMOTE_CHAINS ? (1 << REMOTE_CHAIN_SLOT_BITS) : 0;
+
+  static_assert(
+    SIZECLASS_LOOKUP_LIMIT < SUPERSLAB_SIZE,
+    "Sizes of a superslab or more are not mapped to sizeclasses");
   static_assert(
     INTERMEDIATE_BITS < MIN_ALLOC_BITS,
     "INTERMEDIATE_BITS must be less than MIN_ALLOC_BITS");
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "../ds/flaglock.h"
 #include "../mem/baseslab.h"
 #include "remoteallocator.h"
 
@@ -7,6 +8,14 @@ namespace snmalloc
 {
   class Allocslab : public Baseslab
   {
+    friend class OwnedSlabs;
+
+    // Every superslab and mediumslab is also on the list of chunks owned by
+    // its allocator, so that they can be enumerated.  These fit in the
+    // padding before the cache aligned fields of both views.
+    Allocslab* owned_next;
+    Allocslab* owned_prev;
+
   protected:
     RemoteAllocator* allocator;
 
@@ -16,4 +25,74 @@ namespace snmalloc
       return allocator;
     }
   };
+
+  /**
+   * The superslabs and mediumslabs owned by an allocator.  The owning thread
+   * only changes the list when it acquires or releases a chunk, which is
+   * already a slow path, so the list is protected by a lock that lets other
+   * threads enumerate the chunks without stopping the owner for long.
+   */
+  class OwnedSlabs
+  {
+    Allocslab* head = nullptr;
+    std::atomic_flag lock = ATOMIC_FLAG_INIT;
+
+  public:
+    void insert(Allocslab* slab)
+    {
+      FlagLock f(lock);
+      slab->owned_prev = nullptr;
+      slab->owned_next = head;
+      if (head != nullptr)
+        head->owned_prev = slab;
+      head = slab;
+    }
+
+    void remove(Allocslab* slab)
+    {
+      FlagLock f(lock);
+      if (slab->owned_prev != nullptr)
+        slab->owned_prev->owned_next = slab->owned_next;
+      else
+        head = slab->owned_next;
+
+      if (slab->owned_next != nullptr)
+        slab->owned_next->owned_prev = slab->owned_prev;
+    }
+
+    /**
+     * Call `f` on each chunk.  Chunks cannot be added or removed while this
+     * runs, but the owning thread may still allocate and deallocate objects
+     * in them.
+     */
+    template<typename F>
+    void iterate(F f)
+    {
+      FlagLock l(lock);
+      for (Allocslab* slab = head; slab != nullptr; slab = slab->owned_next)
+        f(slab);
+    }
+
+    /**
+     * Empty the list, then call `f` on each chunk that was on it.  `f` may
+     * free the chunk.
+     */
+    template<typename F>
+    void remove_all(F f)
+    {
+      Allocslab* slab;
+      {
+        FlagLock l(lock);
+        slab = head;
+        head = nullptr;
+      }
+
+      while (slab != nullptr)
+      {
+        Allocslab* next = slab->owned_next;
+        f(slab);
+        slab = next;
+      }
+    }
+  };
 } // namespace snmalloc
@@ -3,6 +3,7 @@
 #include "../ds/bits.h"
 #include "../mem/sizeclass.h"
 
+#include <atomic>
 #include <cstdint>
 
 #ifdef USE_SNMALLOC_STATS
@@ -15,6 +16,138 @@
 
 namespace snmalloc
 {
+  /**
+   * A count that only its owning thread updates, but that other threads may
+   * read at any time, for example to aggregate statistics.  Updates are a
+   * relaxed load and store rather than an atomic read-modify-write, so they
+   * cost the same as incrementing a `size_t`, but reads are never torn.
+   */
+  class RelaxedCounter
+  {
+    std::atomic<size_t> value{0};
+
+  public:
+    operator size_t() const
+    {
+      return value.load(std::memory_order_relaxed);
+    }
+
+    RelaxedCounter& operator+=(size_t n)
+    {
+      value.store(
+        value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+      return *this;
+    }
+
+    void operator++(int)
+    {
+      *this += 1;
+    }
+  };
+
+  /**
+   * Histogram of durations in `Aal::tick()` units, with one bucket per power
+   * of two.  Bucket `i` counts durations in [2^(i-1), 2^i), and bucket 0
+   * durations of zero.  Recording is a count of leading zeros and an
+   * increment, so these are maintained in every build.  `Counter` is
+   * `std::atomic<size_t>` for histograms shared between threads, and
+   * `RelaxedCounter` for those of a single allocator.
+   */
+  template<typename Counter = size_t>
+  struct TickHistogram
+  {
+    static constexpr size_t BUCKETS = bits::BITS + 1;
+
+    Counter buckets[BUCKETS] = {};
+
+    static size_t bucket(uint64_t ticks)
+    {
+      if (ticks == 0)
+        return 0;
+
+      size_t t = static_cast<size_t>(
+        bits::min<uint64_t>(ticks, static_cast<size_t>(-1)));
+      return bits::BITS - bits::clz(t);
+    }
+
+    /**
+     * The longest duration counted in bucket `i`.
+     */
+    static uint64_t bucket_max(size_t i)
+    {
+      if (i >= 64)
+        return UINT64_MAX;
+      return bits::one_at_bit<uint64_t>(i) - 1;
+    }
+
+    void record(uint64_t ticks)
+    {
+      buckets[bucket(ticks)]++;
+    }
+
+    size_t count()
+    {
+      size_t total = 0;
+      for (size_t i = 0; i < BUCKETS; i++)
+        total += buckets[i];
+      return total;
+    }
+
+    /**
+     * An upper bound on the `percent`th percentile duration: the longest
+     * duration in the bucket that contains it.  Returns zero if nothing has
+     * been recorded.
+     */
+    uint64_t percentile(double percent)
+    {
+      size_t total = count();
+      if (total == 0)
+        return 0;
+
+      // The rank of the percentile, counting from one.
+      double rank = static_cast<double>(total) * bits::min(percent, 100.0) /
+        100.0;
+      size_t target = bits::max<size_t>(static_cast<size_t>(rank), 1);
+      if (static_cast<double>(target) < rank)
+        target++;
+
+      size_t seen = 0;
+      for (size_t i = 0; i < BUCKETS; i++)
+      {
+        seen += buckets[i];
+        if (seen >= target)
+          return bucket_max(i);
+      }
+      return bucket_max(BUCKETS - 1);
+    }
+
+    template<typename C>
+    void add(TickHistogram<C>& that)
+    {
+      for (size_t i = 0; i < BUCKETS; i++)
+        buckets[i] += that.buckets[i];
+    }
+  };
+
+  /**
+   * Records the time from its construction to its destruction in a
+   * `TickHistogram`.
+   */
+  template<typename Histogram>
+  class TickTimer
+  {
+    Histogram& histogram;
+    uint64_t start;
+
+  public:
+    TickTimer(Histogram& h) : histogram(h), start(Aal::tick()) {}
+
+    ~TickTimer()
+    {
+      histogram.record(Aal::tick() - start);
+    }
+  };
+
   template<size_t N, size_t LARGE_N>
   struct AllocStats
   {
@@ -117,6 +250,56 @@ namespace snmalloc
 #endif
     };
 
+    /**
+     * Per-sizeclass counters that are maintained in every build, not just
+     * with `USE_SNMALLOC_STATS`.  They are only updated on slow paths, so
+     * they are cheap enough to leave enabled in production.
+     *
+     * Objects are counted when they move from a slab into a fast free list
+     * (or are returned directly by a refill), so the number of objects handed
+     * out is exact up to the contents of the fast free lists, which hold at
+     * most one refill's worth of objects per sizeclass.
+     */
+    struct SlowPathCounters
+    {
+      /// Slabs (small or medium) acquired for and released by this class.
+      RelaxedCounter slabs_acquired;
+      RelaxedCounter slabs_released;
+      /// Number of fast free list refills, and the objects they supplied.
+      RelaxedCounter refills;
+      RelaxedCounter refilled_objects;
+      /// Objects of this class freed by other threads and received here.
+      RelaxedCounter remote_received;
+
+      size_t current_slabs()
+      {
+        return slabs_acquired - slabs_released;
+      }
+
+      void add(SlowPathCounters& that)
+      {
+        slabs_acquired += that.slabs_acquired;
+        slabs_released += that.slabs_released;
+        refills += that.refills;
+        refilled_objects += that.refilled_objects;
+        remote_received += that.remote_received;
+      }
+    };
+
+    SlowPathCounters counters[N];
+
+    /// Large allocations and deallocations, by large class.
+    RelaxedCounter large_allocs[LARGE_N];
+    RelaxedCounter large_deallocs[LARGE_N];
+
+    /// Number of times the remote cache was sent to other allocators.
+    RelaxedCounter remote_posts;
+
+    /// Latency of the allocator's slow paths, in `Aal::tick()` units.
+    TickHistogram<RelaxedCounter> alloc_slab_latency;
+    TickHistogram<RelaxedCounter> large_alloc_latency;
+    TickHistogram<RelaxedCounter> message_queue_latency;
+
 #ifdef USE_SNMALLOC_STATS
     static constexpr size_t BUCKETS_BITS = 4;
     static constexpr size_t BUCKETS = 1 << BUCKETS_BITS;
@@ -132,6 +315,8 @@ namespace snmalloc
     size_t remote_freed = 0;
     size_t remote_posted = 0;
     size_t remote_received = 0;
+    size_t remote_chains_received = 0;
+    size_t remote_chain_objects_received = 0;
     size_t superslab_push_count = 0;
     size_t superslab_pop_count = 0;
     size_t superslab_fresh_count = 0;
@@ -193,7 +378,7 @@ namespace snmalloc
 
     void large_alloc(size_t sc)
     {
-      UNUSED(sc);
+      large_allocs[sc]++;
 
 #ifdef USE_SNMALLOC_STATS
       large_pop_count[sc]++;
@@ -202,7 +387,7 @@ namespace snmalloc
 
     void sizeclass_alloc_slab(sizeclass_t sc)
     {
-      UNUSED(sc);
+      counters[sc].slabs_acquired++;
 
 #ifdef USE_SNMALLOC_STATS
       sizeclass[sc].addToRunningAverage();
@@ -212,7 +397,7 @@ namespace snmalloc
 
     void sizeclass_dealloc_slab(sizeclass_t sc)
     {
-      UNUSED(sc);
+      counters[sc].slabs_released++;
 
 #ifdef USE_SNMALLOC_STATS
       sizeclass[sc].addToRunningAverage();
@@ -222,13 +407,23 @@ namespace snmalloc
 
     void large_dealloc(size_t sc)
     {
-      UNUSED(sc);
+      large_deallocs[sc]++;
 
 #ifdef USE_SNMALLOC_STATS
       large_push_count[sc]++;
 #endif
     }
 
+    /**
+     * A fast free list for `sc` was refilled with `objects` objects taken
+     * from a slab.
+     */
+    void sizeclass_refill(sizeclass_t sc, size_t objects)
+    {
+      counters[sc].refills++;
+      counters[sc].refilled_objects += objects;
+    }
+
     void segment_create()
     {
 #ifdef USE_SNMALLOC_STATS
@@ -268,6 +463,8 @@ namespace snmalloc
 
     void remote_post()
     {
+      remote_posts++;
+
 #ifdef USE_SNMALLOC_STATS
       remote_posted = remote_freed;
 #endif
@@ -275,16 +472,59 @@ namespace snmalloc
 
     void remote_receive(sizeclass_t sc)
     {
-      UNUSED(sc);
+      counters[sc].remote_received++;
 
 #ifdef USE_SNMALLOC_STATS
       remote_received += sizeclass_to_size(sc);
 #endif
     }
 
+    void remote_chain_receive(sizeclass_t sc, size_t length)
+    {
+      counters[sc].remote_received += length;
+
+#ifdef USE_SNMALLOC_STATS
+      for (size_t i = 0; i < length; i++)
+        sizeclass_dealloc(sc);
+
+      remote_received += sizeclass_to_size(sc) * length;
+      remote_chains_received++;
+      remote_chain_objects_received += length;
+#endif
+    }
+
+    /**
+     * Average number of objects in each run of remote deallocations received
+     * when `REMOTE_CHAINS` is enabled.
+     */
+    double average_remote_chain_length()
+    {
+#ifdef USE_SNMALLOC_STATS
+      if (remote_chains_received == 0)
+        return 0;
+
+      return static_cast<double>(remote_chain_objects_received) /
+        static_cast<double>(remote_chains_received);
+#else
+      return 0;
+#endif
+    }
+
     void add(AllocStats<N, LARGE_N>& that)
     {
-      UNUSED(that);
+      for (size_t i = 0; i < N; i++)
+        counters[i].add(that.counters[i]);
+
+      for (size_t i = 0; i < LARGE_N; i++)
+      {
+        large_allocs[i] += that.large_allocs[i];
+        large_deallocs[i] += that.large_deallocs[i];
+      }
+
+      remote_posts += that.remote_posts;
+      alloc_slab_latency.add(that.alloc_slab_latency);
+      large_alloc_latency.add(that.large_alloc_latency);
+      message_queue_latency.add(that.message_queue_latency);
 
 #ifdef USE_SNMALLOC_STATS
       for (size_t i = 0; i < N; i++)
@@ -302,6 +542,8 @@ namespace snmalloc
       remote_freed += that.remote_freed;
       remote_posted += that.remote_posted;
       remote_received += that.remote_received;
+      remote_chains_received += that.remote_chains_received;
+      remote_chain_objects_received += that.remote_chain_objects_received;
       superslab_pop_count += that.superslab_pop_count;
       superslab_push_count += that.superslab_push_count;
       superslab_fresh_count += that.superslab_fresh_count;
@@ -310,6 +552,24 @@ namespace snmalloc
     }
 
 #ifdef USE_SNMALLOC_STATS
+    static void print_latency(
+      CSVStream& csv,
+      uint64_t dumpid,
+      uint64_t allocatorid,
+      const char* path,
+      TickHistogram<RelaxedCounter>& histogram)
+    {
+      for (size_t i = 0; i < TickHistogram<>::BUCKETS; i++)
+      {
+        if (histogram.buckets[i] == 0)
+          continue;
+
+        csv << "Latency" << dumpid << allocatorid << path << i
+            << TickHistogram<>::bucket_max(i) << size_t(histogram.buckets[i])
+            << csv.endl;
+      }
+    }
+
     template<class Alloc>
     void print(std::ostream& o, uint64_t dumpid = 0, uint64_t allocatorid = 0)
     {
@@ -329,6 +589,8 @@ namespace snmalloc
             << "Remote freed"
             << "Remote posted"
             << "Remote received"
+            << "Remote chains received"
+            << "Remote chain objects received"
             << "Superslab pop"
             << "Superslab push"
             << "Superslab fresh"
@@ -363,6 +625,14 @@ namespace snmalloc
             << "Low size"
             << "High size"
             << "Count" << csv.endl;
+
+        csv << "Latency"
+            << "DumpID"
+            << "AllocatorID"
+            << "Path"
+            << "Bucket"
+            << "Max ticks"
+            << "Count" << csv.endl;
       }
 
       for (sizeclass_t i = 0; i < N; i++)
@@ -403,8 +673,15 @@ namespace snmalloc
             << bucketed_requests[i] << csv.endl;
       }
 
+      print_latency(csv, dumpid, allocatorid, "alloc_slab", alloc_slab_latency);
+      print_latency(
+        csv, dumpid, allocatorid, "large_alloc", large_alloc_latency);
+      print_latency(
+        csv, dumpid, allocatorid, "message_queue", message_queue_latency);
+
       csv << "GlobalStats" << dumpid << allocatorid << remote_freed
-          << remote_posted << remote_received << superslab_pop_count
+          << remote_posted << remote_received << remote_chains_received
+          << remote_chain_objects_received << superslab_pop_count
           << superslab_push_count << superslab_fresh_count << segment_count
           << csv.endl;
     }
@@ -225,6 +225,15 @@ namespace snmalloc
       PagemapProvider::pagemap().set_range(p, CMNotOurs, count);
     }
 
+    /**
+     * Set the entry for the chunk at `p` back to `entry`, a value previously
+     * returned by `get`.
+     */
+    static void restore(void* p, uint8_t entry)
+    {
+      set(p, entry);
+    }
+
   private:
     /**
      * Helper function to set a pagemap entry.  This is not part of the public
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "mediumslab.h"
+#include "superslab.h"
+
+namespace snmalloc
+{
+  /**
+   * Occupancy of the slabs of one sizeclass.
+   */
+  struct SlabOccupancy
+  {
+    /**
+     * Slabs are counted in buckets by the fraction of their objects that are
+     * in use: [0%, 25%), [25%, 50%), [50%, 75%), [75%, 100%) and full.
+     */
+    static constexpr size_t BUCKETS = 5;
+
+    size_t slabs = 0;
+    size_t live_objects = 0;
+    size_t capacity = 0;
+    size_t occupancy[BUCKETS] = {};
+
+    void add_slab(size_t live, size_t slab_capacity)
+    {
+      live = bits::min(live, slab_capacity);
+      slabs++;
+      live_objects += live;
+      capacity += slab_capacity;
+      occupancy[(live * (BUCKETS - 1)) / slab_capacity]++;
+    }
+
+    void add(const SlabOccupancy& that)
+    {
+      slabs += that.slabs;
+      live_objects += that.live_objects;
+      capacity += that.capacity;
+      for (size_t i = 0; i < BUCKETS; i++)
+        occupancy[i] += that.occupancy[i];
+    }
+  };
+
+  /**
+   * A snapshot of how full the slabs owned by a set of allocators are, per
+   * sizeclass, for finding the sizeclasses responsible for memory that is
+   * resident but not in use.
+   *
+   * Objects that the owning allocator holds in its free lists, or has
+   * handed to another thread that has not yet freed them remotely, count as
+   * live.  The part of a slab that has not yet been bump allocated does not.
+   * Chunks are read while their owners continue to allocate, so the counts
+   * for a slab may be slightly stale, but no chunk is counted twice.
+   */
+  struct FragmentationReport
+  {
+    SlabOccupancy sizeclasses[NUM_SIZECLASSES];
+    size_t superslabs = 0;
+    size_t mediumslabs = 0;
+
+    /**
+     * Account for `super`.  `bump_ptrs` are its owner's per-sizeclass bump
+     * allocation pointers, used to discount objects not yet carved out of
+     * the slabs being bump allocated.
+     */
+    void add_superslab(Superslab* super, void* const* bump_ptrs)
+    {
+      superslabs++;
+
+      for (size_t i = 0; i < SLAB_COUNT; i++)
+      {
+        Slab* slab =
+          pointer_offset(reinterpret_cast<Slab*>(super), i << SLAB_BITS);
+        Metaslab& meta = super->get_meta(slab);
+        sizeclass_t sc = meta.sizeclass;
+        if (meta.is_unused() || (sc >= NUM_SMALL_CLASSES))
+          continue;
+
+        size_t rsize = sizeclass_to_size(sc);
+        size_t capacity =
+          (SLAB_SIZE - get_initial_offset(sc, i == 0)) / rsize;
+        size_t live = meta.needed;
+
+        // A full slab has given all of its free objects to the allocator.
+        // This reads `link` directly, as the owner may be changing `head`.
+        if (meta.link == 1)
+        {
+          live = capacity;
+          void* bp = bump_ptrs[sc];
+          if (
+            (pointer_align_down<SLAB_SIZE, Slab>(bp) == slab) &&
+            (pointer_align_up<SLAB_SIZE>(bp) != bp))
+            live -= pointer_diff(bp, pointer_offset(slab, SLAB_SIZE)) / rsize;
+        }
+
+        sizeclasses[sc].add_slab(live, capacity);
+      }
+    }
+
+    void add_mediumslab(Mediumslab* slab)
+    {
+      mediumslabs++;
+
+      sizeclass_t sc = slab->get_sizeclass();
+      if ((sc < NUM_SMALL_CLASSES) || (sc >= NUM_SIZECLASSES))
+        return;
+
+      sizeclasses[sc].add_slab(
+        slab->allocated_objects(), medium_slab_free(sc));
+    }
+
+    void add(const FragmentationReport& that)
+    {
+      superslabs += that.superslabs;
+      mediumslabs += that.mediumslabs;
+      for (size_t i = 0; i < NUM_SIZECLASSES; i++)
+        sizeclasses[i].add(that.sizeclasses[i]);
+    }
+
+    /**
+     * Bytes of slab capacity in sizeclass `sc` that are not in use.
+     */
+    size_t free_bytes(sizeclass_t sc)
+    {
+      auto& s = sizeclasses[sc];
+      return (s.capacity - s.live_objects) * sizeclass_to_size(sc);
+    }
+  };
+} // namespace snmalloc
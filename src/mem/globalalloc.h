@@ -31,15 +31,91 @@ namespace snmalloc
 
     Alloc* acquire()
     {
-      return Parent::acquire(Parent::memory_provider);
+      Alloc* a = extract_preferred();
+      if (a != nullptr)
+        a->set_in_use();
+      else
+        a = Parent::acquire(Parent::memory_provider);
+
+      a->pool.store(this, std::memory_order_release);
+
+      // Another thread may be draining this allocator's message queue.  Now
+      // that it is marked as in use no new drain can start, so wait for any
+      // current one to hand the allocator back.
+      FlagLock f(a->drain_lock);
+      return a;
     }
 
     void release(Alloc* a)
     {
+      // Return cached remote deallocations now, as this allocator may not be
+      // used again for some time.
+      a->flush_remote();
+      a->tag.store(0, std::memory_order_relaxed);
       Parent::release(a);
     }
 
+  private:
+    /**
+     * The number of released allocators considered by `acquire`.
+     */
+    static constexpr size_t ACQUIRE_CANDIDATES = 4;
+
+    /**
+     * Take the top few released allocators off the free stack and keep the
+     * one with the most memory ready to reuse, so that new threads pick up
+     * the partially used slabs and warm free lists left by exited ones.  The
+     * others are put back in their original order, untouched, so the cost is
+     * bounded by `ACQUIRE_CANDIDATES`.  Memory they leave free is returned
+     * by the periodic orphan drain instead.
+     */
+    Alloc* extract_preferred()
+    {
+      Alloc* candidates[ACQUIRE_CANDIDATES];
+      size_t count = 0;
+      size_t best = 0;
+      size_t best_score = 0;
+
+      while (count < ACQUIRE_CANDIDATES)
+      {
+        Alloc* a = Parent::extract_one();
+        if (a == nullptr)
+          break;
+
+        // Another thread may be draining this allocator, in which case its
+        // state cannot be inspected.
+        size_t score = 0;
+        if (!a->drain_lock.test_and_set())
+        {
+          score = a->reuse_score();
+          a->drain_lock.clear(std::memory_order_release);
+        }
+
+        if ((count == 0) || (score > best_score))
+        {
+          best = count;
+          best_score = score;
+        }
+        candidates[count++] = a;
+      }
+
+      for (size_t i = count; i > 0; i--)
+      {
+        if ((i - 1) != best)
+          Parent::restore(candidates[i - 1], candidates[i - 1]);
+      }
+
+      return (count == 0) ? nullptr : candidates[best];
+    }
+
   public:
+    /**
+     * Sum the statistics of every allocator in the pool into `stats`.  The
+     * slow path counters are available in every build; the remaining fields
+     * require `USE_SNMALLOC_STATS`.  The slow path counters of allocators
+     * owned by other threads are read atomically, but may be slightly stale;
+     * the remaining fields are read without synchronisation.
+     */
     void aggregate_stats(Stats& stats)
     {
       auto* alloc = Parent::iterate();
@@ -51,6 +127,59 @@ namespace snmalloc
       }
     }
 
+    /**
+     * Call `f` on every allocator in the pool, whether or not it is owned by
+     * a thread.  Allocators are never removed from the pool, so this is safe
+     * to call concurrently with threads starting and exiting.
+     */
+    template<typename F>
+    void for_each(F f)
+    {
+      auto* alloc = Parent::iterate();
+
+      while (alloc != nullptr)
+      {
+        f(alloc);
+        alloc = Parent::iterate(alloc);
+      }
+    }
+
+    /**
+     * Returns the bytes of deallocations held in the allocators' remote
+     * caches, and the bytes waiting in their message queues.
+     */
+    std::pair<size_t, size_t> remote_bytes()
+    {
+      size_t cached = 0;
+      size_t queued = 0;
+      auto* alloc = Parent::iterate();
+
+      while (alloc != nullptr)
+      {
+        cached += alloc->remote_cached_bytes();
+        queued += alloc->remote_queued_bytes();
+        alloc = Parent::iterate(alloc);
+      }
+
+      return {cached, queued};
+    }
+
+    /**
+     * Add the slab occupancy of every allocator in the pool to `report`.
+     * Each allocator's chunks are walked in turn, so no thread is held up for
+     * longer than it takes to walk one allocator.
+     */
+    void report_fragmentation(FragmentationReport& report)
+    {
+      auto* alloc = Parent::iterate();
+
+      while (alloc != nullptr)
+      {
+        alloc->report_fragmentation(report);
+        alloc = Parent::iterate(alloc);
+      }
+    }
+
 #ifdef USE_SNMALLOC_STATS
     void print_all_stats(std::ostream& o, uint64_t dumpid = 0)
     {
@@ -70,6 +199,72 @@ namespace snmalloc
     }
 #endif
 
+    /**
+     * Take over an allocator that is not owned by any thread, process its
+     * message queue and return its cached free objects to their slabs.
+     * Returns false, without doing anything, if the allocator is in use or
+     * another thread is already draining it.
+     */
+    bool try_drain(Alloc* alloc)
+    {
+#ifndef USE_MALLOC
+      if (alloc->drain_lock.test_and_set())
+        return false;
+
+      bool idle = !alloc->is_in_use();
+      if (idle)
+      {
+        alloc->draining = true;
+        alloc->drain_orphan();
+        alloc->draining = false;
+      }
+
+      alloc->drain_lock.clear(std::memory_order_release);
+      return idle;
+#else
+      UNUSED(alloc);
+      return false;
+#endif
+    }
+
+    /**
+     * Drain the message queues of allocators that are not owned by a thread
+     * and have at least `threshold` bytes of deallocations waiting.  This is
+     * called automatically when a remote post takes a queue over
+     * `REMOTE_QUEUE_THRESHOLD`.  Allocators that are in use are left to
+     * their owning thread.
+     */
+    void drain_overloaded(size_t threshold = REMOTE_QUEUE_THRESHOLD)
+    {
+      auto* alloc = Parent::iterate();
+
+      while (alloc != nullptr)
+      {
+        if (alloc->remote_queued_bytes() >= threshold)
+          try_drain(alloc);
+        alloc = Parent::iterate(alloc);
+      }
+    }
+
+    /**
+     * Called periodically from the slow path of `self`.  Drains a few of the
+     * allocators that are not owned by a thread, continuing round the pool
+     * from where `self` last stopped.
+     */
+    void drain_orphans(Alloc* self)
+    {
+      for (size_t i = 0; i < ORPHAN_DRAIN_BATCH; i++)
+      {
+        Alloc* alloc = Parent::iterate(self->orphan_drain_cursor);
+        if (alloc == nullptr)
+          alloc = Parent::iterate();
+
+        self->orphan_drain_cursor = alloc;
+        if (alloc != self)
+          try_drain(alloc);
+      }
+    }
+
     void cleanup_unused()
     {
 #ifndef USE_MALLOC
@@ -85,12 +280,19 @@ namespace snmalloc
       {
         while (alloc != nullptr)
         {
-          alloc->handle_message_queue();
+          // Skip any allocator another thread is already draining.
+          if (!alloc->drain_lock.test_and_set())
+          {
+            alloc->draining = true;
+            alloc->handle_message_queue();
+            alloc->draining = false;
+            alloc->drain_lock.clear(std::memory_order_release);
+          }
           last = alloc;
           alloc = Parent::extract(alloc);
         }
 
-        restore(first, last);
+        Parent::restore(first, last);
       }
 #endif
     }
@@ -123,7 +325,7 @@ namespace snmalloc
 
           // Post all remotes, including forwarded ones. If any allocator posts,
           // repeat the loop.
-          if (alloc->remote.capacity < REMOTE_CACHE)
+          if (alloc->remote.has_pending())
           {
             alloc->stats().remote_post();
             alloc->remote.post(alloc->id());
@@ -191,6 +393,22 @@ namespace snmalloc
       AllocPool<GlobalVirtual, Alloc>::make>::get();
   }
 
+  inline AllocPool<GlobalVirtual, Alloc>* make_arena_pool() noexcept
+  {
+    return AllocPool<GlobalVirtual, Alloc>::make();
+  }
+
+  /**
+   * The pool of allocators used as arenas.  It is kept apart from the pool
+   * of thread allocators, so that an arena never starts out holding memory,
+   * such as the live objects of an exited thread, that destroying the arena
+   * would free.
+   */
+  inline AllocPool<GlobalVirtual, Alloc>*& current_arena_pool()
+  {
+    return Singleton<AllocPool<GlobalVirtual, Alloc>*, make_arena_pool>::get();
+  }
+
   template<class MemoryProvider, class Alloc>
   inline AllocPool<MemoryProvider, Alloc>* make_alloc_pool(MemoryProvider& mp)
   {
@@ -0,0 +1,242 @@
+#pragma once
+
+#include "../ds/addresstable.h"
+#include "../ds/helpers.h"
+#include "allocconfig.h"
+#include "largealloc.h"
+
+#include <atomic>
+#include <cmath>
+#include <stdio.h>
+
+namespace snmalloc
+{
+  /**
+   * Sampling heap profiler, compiled in with `HEAP_PROFILING`.
+   *
+   * Each allocator counts down the bytes it allocates and, when the count
+   * expires, records the object and the call stack in a global side table.
+   * The intervals between samples are exponentially distributed with a mean
+   * of `interval()` bytes, so sampling is a Poisson process over allocated
+   * bytes.  Sampled objects are removed from the table when they are freed,
+   * so a dump shows where the live heap was allocated.
+   */
+  class HeapProfile
+  {
+  public:
+    /**
+     * The number of return addresses recorded for each sample.
+     */
+    static constexpr size_t DEPTH = 32;
+
+    /**
+     * While sampling is disabled, allocators check whether it has been
+     * enabled after allocating this many bytes.
+     */
+    static constexpr size_t RECHECK_INTERVAL = 1 << 16;
+
+  private:
+    struct Sample
+    {
+      std::atomic<uintptr_t> address;
+      size_t size;
+      size_t depth;
+      void* frames[DEPTH];
+    };
+
+    /**
+     * Objects are at least MIN_ALLOC_SIZE aligned.  Samples are dropped if
+     * there is no free slot within 32 of their hash.
+     */
+    using SampleTable = AddressTable<Sample, 13, 32, MIN_ALLOC_BITS>;
+
+    inline static std::atomic<size_t> sample_interval{HEAP_PROFILE_INTERVAL};
+
+    /**
+     * The most recent non-zero interval, reported in dumps so that pprof can
+     * scale samples taken before sampling was disabled.
+     */
+    inline static std::atomic<size_t> last_interval{HEAP_PROFILE_INTERVAL};
+    inline static std::atomic<size_t> live_samples{0};
+    inline static std::atomic<size_t> total_samples{0};
+    inline static std::atomic<size_t> total_sampled_bytes{0};
+    inline static std::atomic<size_t> dropped_samples{0};
+
+    static SampleTable* make_table() noexcept
+    {
+      auto* table = default_memory_provider().alloc_chunk<SampleTable, 1>();
+      if (table == nullptr)
+        error("Failed to allocate the heap profile table");
+      return table;
+    }
+
+    static SampleTable& table()
+    {
+      return *Singleton<SampleTable*, make_table>::get();
+    }
+
+  public:
+    /**
+     * The mean number of bytes between samples, or zero if sampling is
+     * disabled.
+     */
+    static size_t interval()
+    {
+      return sample_interval.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Set the mean number of bytes between samples.  Zero disables sampling;
+     * objects that have already been sampled are still tracked until they
+     * are freed.  Allocators pick up a change within `RECHECK_INTERVAL`
+     * bytes, or at their next sample.
+     */
+    static void set_interval(size_t bytes)
+    {
+      if (bytes != 0)
+      {
+        table();
+        last_interval.store(bytes, std::memory_order_relaxed);
+      }
+      sample_interval.store(bytes, std::memory_order_relaxed);
+    }
+
+    /**
+     * Returns true if any sampled object has not yet been freed, in which
+     * case deallocations must be checked against the table.
+     */
+    SNMALLOC_FAST_PATH static bool has_samples()
+    {
+      return live_samples.load(std::memory_order_relaxed) != 0;
+    }
+
+    /**
+     * Draw the number of bytes until the next sample from an exponential
+     * distribution with mean `mean`, using and updating the xorshift state
+     * `rng`.
+     */
+    static size_t next_countdown(uint64_t& rng, size_t mean)
+    {
+      rng ^= rng << 13;
+      rng ^= rng >> 7;
+      rng ^= rng << 17;
+
+      // Uniform in (0, 1].
+      double u = static_cast<double>((rng >> 11) + 1) * 0x1.0p-53;
+      double next = -std::log(u) * static_cast<double>(mean);
+
+      if (next < 1)
+        return 1;
+      if (next > static_cast<double>(bits::one_at_bit(bits::BITS - 2)))
+        return bits::one_at_bit(bits::BITS - 2);
+      return static_cast<size_t>(next);
+    }
+
+    /**
+     * Record `p`, an allocation of `size` bytes, with the current call stack.
+     */
+    template<typename PAL>
+    SNMALLOC_SLOW_PATH static void record(void* p, size_t size)
+    {
+      total_samples++;
+      total_sampled_bytes += size;
+
+      bool recorded = table().insert(p, [size](Sample& s) {
+        s.size = size;
+        s.depth = PAL::capture_stack(s.frames, DEPTH);
+
+        // Count the sample before publishing it, so that a thread that is
+        // handed `p` sees `has_samples()`.
+        live_samples++;
+      });
+
+      if (!recorded)
+        dropped_samples++;
+    }
+
+    /**
+     * Forget `p` if it was sampled.
+     */
+    SNMALLOC_SLOW_PATH static void remove(void* p)
+    {
+      if (p == nullptr)
+        return;
+
+      table().remove(p, [](void*, Sample&) { live_samples--; });
+    }
+
+    /**
+     * Forget every sampled object for which `pred` returns true.  Used when
+     * objects are freed in bulk without being passed to `remove`.
+     */
+    template<typename F>
+    static void remove_if(F pred)
+    {
+      table().remove_if(
+        [&pred](void* p, Sample&) { return pred(p); },
+        [](void*, Sample&) { live_samples--; });
+    }
+
+    /**
+     * Number of samples that were not recorded because the table was full
+     * around their address.
+     */
+    static size_t dropped()
+    {
+      return dropped_samples;
+    }
+
+    /**
+     * Write the live samples to `out` in the legacy text format understood
+     * by pprof (`heap_v2`), followed by the process's mappings if they are
+     * available.  Samples that are added or removed during the dump may or
+     * may not appear.
+     */
+    static void dump(FILE* out)
+    {
+      size_t live_count = 0;
+      size_t live_bytes = 0;
+      table().for_each([&](void*, Sample& s) {
+        live_count++;
+        live_bytes += s.size;
+      });
+
+      fprintf(
+        out,
+        "heap profile: %zu: %zu [%zu: %zu] @ heap_v2/%zu\n",
+        live_count,
+        live_bytes,
+        total_samples.load(),
+        total_sampled_bytes.load(),
+        last_interval.load());
+
+      table().for_each([out](void* p, Sample& s) {
+        size_t size = s.size;
+        size_t depth = bits::min(s.depth, DEPTH);
+        void* frames[DEPTH];
+        for (size_t j = 0; j < depth; j++)
+          frames[j] = s.frames[j];
+
+        // Skip the sample if it was replaced while it was copied.
+        if (!SampleTable::still_holds(s, p))
+          return;
+
+        fprintf(out, "1: %zu [1: %zu] @", size, size);
+        for (size_t j = 0; j < depth; j++)
+          fprintf(out, " %p", frames[j]);
+        fprintf(out, "\n");
+      });
+
+      FILE* maps = fopen("/proc/self/maps", "r");
+      if (maps != nullptr)
+      {
+        fprintf(out, "\nMAPPED_LIBRARIES:\n");
+        char buffer[4096];
+        size_t n;
+        while ((n = fread(buffer, 1, sizeof(buffer), maps)) != 0)
+          fwrite(buffer, 1, n, out);
+        fclose(maps);
+      }
+    }
+  };
+} // namespace snmalloc
@@ -7,6 +7,7 @@
 #include "address_space.h"
 #include "allocstats.h"
 #include "baseslab.h"
+#include "largeowners.h"
 #include "sizeclass.h"
 
 #include <new>
@@ -53,6 +54,17 @@ namespace snmalloc
     }
   };
 
+  /**
+   * What a chunk handed out by the memory provider is used for.
+   */
+  enum ChunkUse
+  {
+    SmallChunk,
+    MediumChunk,
+    LargeChunk,
+    CHUNK_USES
+  };
+
   // This represents the state that the large allcoator needs to add to the
   // global state of the allocator.  This is currently stored in the memory
   // provider, so we add this in.
@@ -75,6 +87,13 @@ namespace snmalloc
      */
     std::atomic<size_t> peak_memory_used_bytes{0};
 
+    /**
+     * The allocators charged for live large allocations, created on first
+     * use.
+     */
+    std::atomic<LargeOwnerTable*> large_owners{nullptr};
+    std::atomic_flag large_owners_lock = ATOMIC_FLAG_INIT;
+
   public:
     using Pal = PAL;
 
@@ -83,11 +102,63 @@ namespace snmalloc
      */
     std::atomic<size_t> available_large_chunks_in_bytes{0};
 
+    /**
+     * Bytes that have been decommitted: the part of
+     * `available_large_chunks_in_bytes`, as every chunk keeps its first page
+     * committed, and `medium_decommitted_bytes`.
+     */
+    std::atomic<size_t> decommitted_bytes{0};
+
+    /**
+     * The part of `decommitted_bytes` that is free medium objects in
+     * mediumslabs still in use.
+     */
+    std::atomic<size_t> medium_decommitted_bytes{0};
+
+    /**
+     * Bytes of chunks currently handed out, by what they are used for.
+     */
+    std::atomic<size_t> chunk_bytes[CHUNK_USES] = {};
+
+    /**
+     * Memory allocated with `alloc_chunk`, for the allocator's own data
+     * structures.
+     */
+    std::atomic<size_t> metadata_bytes{0};
+
     /**
      * Stack of large allocations that have been returned for reuse.
      */
     ModArray<NUM_LARGE_CLASSES, MPMCStack<Largeslab, RequiresInit>> large_stack;
 
+    /**
+     * Number of chunks held in each of the `large_stack`s.
+     */
+    ModArray<NUM_LARGE_CLASSES, std::atomic<size_t>> large_stack_count;
+
+    /**
+     * The decommit policy applied to chunks as they are returned to the
+     * `large_stack`s.  Starts as the compile-time `decommit_strategy` and can
+     * be changed at runtime; chunks already cached keep their state, as each
+     * records whether it was decommitted.
+     */
+    std::atomic<DecommitStrategy> decommit_policy{decommit_strategy};
+
+    /**
+     * Set for providers whose address space may hold stale data, such as a
+     * buffer that is reused by a `Region`.  Chunks taken from the address
+     * space are then marked as used before their headers are read, as they
+     * cannot be assumed to be zero.
+     */
+    bool dirty_address_space = false;
+
+    /**
+     * Latency, in `Aal::tick()` units, of reserving address space for new
+     * chunks and of notifying the platform that cached chunks are reused.
+     */
+    TickHistogram<std::atomic<size_t>> reserve_latency;
+    TickHistogram<std::atomic<size_t>> notify_using_latency;
+
     /**
      * Make a new memory provide for this PAL.
      */
@@ -118,6 +189,8 @@ namespace snmalloc
 #ifdef GCC_VERSION_EIGHT_PLUS
 #  pragma GCC diagnostic pop
 #endif
+      allocated->metadata_bytes = local.metadata_bytes.load();
+      allocated->peak_memory_used_bytes = local.peak_memory_used_bytes.load();
 
       // Register this allocator for low-memory call-backs
       if constexpr (pal_supports<LowMemoryNotification, PAL>)
@@ -129,13 +202,27 @@ namespace snmalloc
       return allocated;
     }
 
+    /**
+     * Decommit all of the chunks cached in the `large_stack`s, except for
+     * their first page, regardless of the decommit policy.
+     */
+    void decommit_cached()
+    {
+      decommit_large_stacks(false);
+    }
+
   private:
     SNMALLOC_SLOW_PATH void lazy_decommit()
+    {
+      decommit_large_stacks(true);
+    }
+
+    SNMALLOC_SLOW_PATH void decommit_large_stacks(bool under_pressure)
     {
       // If another thread is try to do lazy decommit, let it continue.  If
       // we try to parallelise this, we'll most likely end up waiting on the
       // same page table locks.
-      if (!lazy_decommit_guard.test_and_set())
+      if (lazy_decommit_guard.test_and_set())
       {
         return;
       }
@@ -147,9 +234,16 @@ namespace snmalloc
       for (size_t large_class = 0; large_class < NUM_LARGE_CLASSES;
            large_class++)
       {
-        if (!PAL::expensive_low_memory_check())
+        if constexpr (pal_supports<LowMemoryNotification, PAL>)
         {
-          break;
+          if (under_pressure && !PAL::expensive_low_memory_check())
+          {
+            break;
+          }
+        }
+        else
+        {
+          UNUSED(under_pressure);
         }
         size_t rsize = bits::one_at_bit(SUPERSLAB_BITS) << large_class;
         size_t decommit_size = rsize - OS_PAGE_SIZE;
@@ -163,6 +257,7 @@ namespace snmalloc
           {
             PAL::notify_not_using(
               pointer_offset(slab, OS_PAGE_SIZE), decommit_size);
+            decommitted_bytes += decommit_size;
           }
           // Once we've removed these from the stack, there will be no
           // concurrent accesses and removal should have established a
@@ -197,11 +292,16 @@ namespace snmalloc
       // Cache line align
       size_t size = bits::align_up(sizeof(T), 64);
       size = bits::next_pow2(bits::max(size, alignment));
-      void* p = address_space.template reserve<true>(size);
+      void* p;
+      {
+        TickTimer timer(reserve_latency);
+        p = address_space.template reserve<true>(size);
+      }
       if (p == nullptr)
         return nullptr;
 
       peak_memory_used_bytes += size;
+      metadata_bytes += size;
 
       return new (p) T(std::forward<Args...>(args)...);
     }
@@ -209,11 +309,54 @@ namespace snmalloc
     template<bool committed>
     void* reserve(size_t large_class) noexcept
     {
+      TickTimer timer(reserve_latency);
       size_t size = bits::one_at_bit(SUPERSLAB_BITS) << large_class;
       peak_memory_used_bytes += size;
       return address_space.template reserve<committed>(size);
     }
 
+    /**
+     * Add the `length` bytes from `base` to the memory this provider hands
+     * out.  The caller retains ownership of the memory, which must outlive
+     * any use of this provider.
+     */
+    void add_range(void* base, size_t length)
+    {
+      address_space.add_external_range(base, length);
+    }
+
+    /**
+     * Returns the table of allocators charged for large allocations, or
+     * nullptr if it has not been created and `create` is false, or could not
+     * be allocated.
+     */
+    LargeOwnerTable* large_owner_table(bool create = true)
+    {
+      LargeOwnerTable* table = large_owners.load(std::memory_order_acquire);
+      if (likely(table != nullptr) || !create)
+        return table;
+
+      FlagLock f(large_owners_lock);
+      table = large_owners.load(std::memory_order_relaxed);
+      if (table == nullptr)
+      {
+        table = alloc_chunk<LargeOwnerTable, 1>();
+        large_owners.store(table, std::memory_order_release);
+      }
+      return table;
+    }
+
+    /**
+     * Returns the number of bytes of address space that have been reserved
+     * from the platform but never handed out.
+     */
+    size_t unused_reserved_bytes()
+    {
+      size_t used = peak_memory_used_bytes;
+      size_t reserved = address_space.reserved();
+      return reserved > used ? reserved - used : 0;
+    }
+
     /**
      * Returns a pair of current memory usage and peak memory usage.
      * Both statistics are very coarse-grained.
@@ -238,7 +381,8 @@ namespace snmalloc
   class LargeAlloc
   {
   public:
-    // This will be a zero-size structure if stats are not enabled.
+    // The slow path counters are kept in every build, the other statistics
+    // only with USE_SNMALLOC_STATS.
     Stats stats;
 
     MemoryProvider& memory_provider;
@@ -246,7 +390,7 @@ namespace snmalloc
     LargeAlloc(MemoryProvider& mp) : memory_provider(mp) {}
 
     template<ZeroMem zero_mem = NoZero, AllowReserve allow_reserve = YesReserve>
-    void* alloc(size_t large_class, size_t size)
+    void* alloc(size_t large_class, size_t size, ChunkUse use)
     {
       size_t rsize = bits::one_at_bit(SUPERSLAB_BITS) << large_class;
       // For superslab size, we always commit the whole range.
@@ -260,21 +404,25 @@ namespace snmalloc
         p = memory_provider.template reserve<false>(large_class);
         if (p == nullptr)
           return nullptr;
+        if (unlikely(memory_provider.dirty_address_space))
+          static_cast<Largeslab*>(p)->init();
+        TickTimer timer(memory_provider.notify_using_latency);
         MemoryProvider::Pal::template notify_using<zero_mem>(p, rsize);
       }
       else
       {
         stats.superslab_pop();
         memory_provider.available_large_chunks_in_bytes -= rsize;
+        memory_provider.large_stack_count[large_class]--;
 
-        // Cross-reference alloc.h's large_dealloc decommitment condition.
+        // Chunks are marked as decommitted by dealloc() and lazy_decommit().
         bool decommitted =
-          ((decommit_strategy == DecommitSuperLazy) &&
-           (static_cast<Baseslab*>(p)->get_kind() == Decommitted)) ||
-          (large_class > 0) || (decommit_strategy == DecommitSuper);
+          static_cast<Baseslab*>(p)->get_kind() == Decommitted;
 
         if (decommitted)
         {
+          memory_provider.decommitted_bytes -= rsize - OS_PAGE_SIZE;
+
           // The first page is already in "use" for the stack element,
           // this will need zeroing for a YesZero call.
           if constexpr (zero_mem == YesZero)
@@ -283,6 +431,7 @@ namespace snmalloc
           // Notify we are using the rest of the allocation.
           // Passing zero_mem ensures the PAL provides zeroed pages if
           // required.
+          TickTimer timer(memory_provider.notify_using_latency);
           MemoryProvider::Pal::template notify_using<zero_mem>(
             pointer_offset(p, OS_PAGE_SIZE), rsize - OS_PAGE_SIZE);
         }
@@ -298,10 +447,11 @@ namespace snmalloc
       }
 
       SNMALLOC_ASSERT(p == pointer_align_up(p, rsize));
+      memory_provider.chunk_bytes[use] += rsize;
       return p;
     }
 
-    void dealloc(void* p, size_t large_class)
+    void dealloc(void* p, size_t large_class, ChunkUse use)
     {
       if constexpr (decommit_strategy == DecommitSuperLazy)
       {
@@ -312,19 +462,31 @@ namespace snmalloc
       }
 
       size_t rsize = bits::one_at_bit(SUPERSLAB_BITS) << large_class;
+      DecommitStrategy policy =
+        memory_provider.decommit_policy.load(std::memory_order_relaxed);
 
-      // Cross-reference largealloc's alloc() decommitted condition.
+      // Record in the chunk whether it was decommitted, for alloc().
+      Largeslab* slab;
       if (
-        (decommit_strategy != DecommitNone) &&
-        (large_class != 0 || decommit_strategy == DecommitSuper))
+        (policy != DecommitNone) &&
+        (large_class != 0 || policy == DecommitSuper))
       {
         MemoryProvider::Pal::notify_not_using(
           pointer_offset(p, OS_PAGE_SIZE), rsize - OS_PAGE_SIZE);
+        memory_provider.decommitted_bytes += rsize - OS_PAGE_SIZE;
+        slab = new (p) Decommittedslab();
+      }
+      else
+      {
+        slab = static_cast<Largeslab*>(p);
+        slab->init();
       }
 
       stats.superslab_push();
+      memory_provider.chunk_bytes[use] -= rsize;
       memory_provider.available_large_chunks_in_bytes += rsize;
-      memory_provider.large_stack[large_class].push(static_cast<Largeslab*>(p));
+      memory_provider.large_stack_count[large_class]++;
+      memory_provider.large_stack[large_class].push(slab);
     }
   };
 
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "../ds/addresstable.h"
+#include "../ds/flaglock.h"
+#include "allocconfig.h"
+
+#include <atomic>
+
+namespace snmalloc
+{
+  /**
+   * Records which allocator each live large allocation is charged to.  Large
+   * allocations are returned to the memory provider by whichever thread
+   * frees them, so this is needed to credit the allocator that made them.
+   *
+   * Allocations that find no free slot near their hash are recorded in an
+   * overflow table, created on demand, so the capacity grows with the number
+   * of live large allocations.  Tables are never freed.
+   */
+  class LargeOwnerTable
+  {
+    struct Entry
+    {
+      std::atomic<uintptr_t> address;
+      std::atomic<size_t>* counter;
+      size_t size;
+    };
+
+    AddressTable<Entry, 12, 64, SUPERSLAB_BITS> table;
+
+    /**
+     * The table used for allocations that do not fit in this one.
+     */
+    std::atomic<LargeOwnerTable*> overflow{nullptr};
+    std::atomic_flag overflow_lock = ATOMIC_FLAG_INIT;
+
+  public:
+    /**
+     * Charge the `size` bytes of the large allocation `p` to `counter`,
+     * allocating overflow tables from `memory_provider` as needed.  Returns
+     * false, without changing `counter`, if no table could be allocated.
+     */
+    template<typename MemoryProvider>
+    bool insert(
+      MemoryProvider& memory_provider,
+      void* p,
+      std::atomic<size_t>* counter,
+      size_t size)
+    {
+      for (LargeOwnerTable* t = this; t != nullptr;)
+      {
+        bool inserted = t->table.insert(p, [=](Entry& e) {
+          e.counter = counter;
+          e.size = size;
+          *counter += size;
+        });
+        if (inserted)
+          return true;
+
+        LargeOwnerTable* next = t->overflow.load(std::memory_order_acquire);
+        if (next == nullptr)
+        {
+          FlagLock f(t->overflow_lock);
+          next = t->overflow.load(std::memory_order_relaxed);
+          if (next == nullptr)
+          {
+            next = memory_provider.template alloc_chunk<LargeOwnerTable, 1>();
+            t->overflow.store(next, std::memory_order_release);
+          }
+        }
+        t = next;
+      }
+
+      return false;
+    }
+
+    /**
+     * Credit the allocator charged for `p`, if any, and forget `p`.
+     */
+    void remove(void* p)
+    {
+      // An allocation is only placed in an overflow table if its slots here
+      // were all in use, and removing entries leaves tombstones, so it is
+      // never found in a later table before it is looked for here.
+      for (LargeOwnerTable* t = this; t != nullptr;
+           t = t->overflow.load(std::memory_order_acquire))
+      {
+        bool removed = t->table.remove(
+          p, [](void*, Entry& e) { *e.counter -= e.size; });
+        if (removed)
+          return;
+      }
+    }
+
+    /**
+     * Forget every allocation charged to `counter`, calling `f` with the
+     * address and size of each.  Allocations charged to `counter` must not
+     * be freed concurrently.
+     */
+    template<typename F>
+    void remove_all(std::atomic<size_t>* counter, F f)
+    {
+      for (LargeOwnerTable* t = this; t != nullptr;
+           t = t->overflow.load(std::memory_order_acquire))
+      {
+        t->table.remove_if(
+          [counter](void*, Entry& e) { return e.counter == counter; },
+          [&f](void* p, Entry& e) {
+            *e.counter -= e.size;
+            f(p, e.size);
+          });
+      }
+    }
+  };
+} // namespace snmalloc
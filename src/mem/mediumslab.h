@@ -19,10 +19,30 @@ namespace snmalloc
     alignas(CACHELINE_SIZE) Mediumslab* next;
     Mediumslab* prev;
 
+    static constexpr size_t BITMAP_WORDS =
+      (SLAB_COUNT + bits::BITS - 1) / bits::BITS;
+
     uint16_t free;
-    uint8_t head;
     uint8_t sizeclass;
-    uint16_t stack[SLAB_COUNT - 1];
+
+    /**
+     * A bit for each object, numbered from the start of the slab, that is set
+     * while the object is free.  The lowest free object is allocated first,
+     * so that free objects gather at the end of the slab.
+     */
+    size_t free_objects[BITMAP_WORDS];
+
+    /**
+     * With `TRACK_ZERO_MEMORY`, a bit for each object that is set while the
+     * object is free and known to be zero.
+     */
+    size_t clean[BITMAP_WORDS];
+
+    /**
+     * A bit for each free object whose interior, the pages that it does not
+     * share with other objects, has been decommitted.
+     */
+    size_t decommitted[BITMAP_WORDS];
 
   public:
     static constexpr uint32_t header_size()
@@ -45,25 +65,42 @@ namespace snmalloc
         const_cast<void*>(p));
     }
 
-    void init(RemoteAllocator* alloc, sizeclass_t sc, size_t rsize)
+    void init(RemoteAllocator* alloc, sizeclass_t sc)
     {
       SNMALLOC_ASSERT(sc >= NUM_SMALL_CLASSES);
       SNMALLOC_ASSERT((sc - NUM_SMALL_CLASSES) < NUM_MEDIUM_CLASSES);
 
       allocator = alloc;
-      head = 0;
 
-      // If this was previously a Mediumslab of the same sizeclass, don't
-      // initialise the allocation stack.
+      // If this was previously a Mediumslab of the same sizeclass, every
+      // object is already free.
       if ((kind != Medium) || (sizeclass != sc))
       {
+        // Memory that has never been used is zero.
+        bool fresh = kind == Fresh;
+
         sizeclass = static_cast<uint8_t>(sc);
-        uint16_t ssize = static_cast<uint16_t>(rsize >> 8);
         kind = Medium;
         free = medium_slab_free(sc);
-        for (uint16_t i = free; i > 0; i--)
-          stack[free - i] =
-            static_cast<uint16_t>((SUPERSLAB_SIZE >> 8) - (i * ssize));
+        for (size_t w = 0; w < BITMAP_WORDS; w++)
+        {
+          size_t first = w * bits::BITS;
+          size_t count =
+            (free > first) ? bits::min(free - first, bits::BITS) : 0;
+          free_objects[w] =
+            (count == bits::BITS) ? ~size_t(0) : bits::one_at_bit(count) - 1;
+          decommitted[w] = 0;
+        }
+
+        if constexpr (TRACK_ZERO_MEMORY)
+        {
+          for (auto& word : clean)
+            word = fresh ? ~size_t(0) : 0;
+        }
+        else
+        {
+          UNUSED(fresh);
+        }
       }
       else
       {
@@ -76,50 +113,221 @@ namespace snmalloc
       return sizeclass;
     }
 
-    template<ZeroMem zero_mem, SNMALLOC_CONCEPT(ConceptPAL) PAL>
-    void* alloc(size_t size)
+    template<ZeroMem zero_mem, typename MemoryProvider>
+    void* alloc(size_t size, MemoryProvider& memory_provider)
     {
+      using PAL = typename MemoryProvider::Pal;
       SNMALLOC_ASSERT(!full());
 
-      uint16_t index = stack[head++];
-      void* p = pointer_offset(this, (static_cast<size_t>(index) << 8));
+      size_t w = 0;
+      while (free_objects[w] == 0)
+        w++;
+      size_t index = (w * bits::BITS) + bits::ctz(free_objects[w]);
+      free_objects[w] &= free_objects[w] - 1;
+      void* p = object_address(index);
       free--;
 
-      if constexpr (zero_mem == YesZero)
-        PAL::zero(p, size);
-      else
-        UNUSED(size);
+      // The object is about to be written, so it is no longer clean.
+      bool known_zero = false;
+      if constexpr (TRACK_ZERO_MEMORY)
+        known_zero = take_clean(index);
+
+      if (unlikely(take_bit(decommitted, index)))
+        recommit<zero_mem>(p, size, memory_provider);
+      else if constexpr (zero_mem == YesZero)
+      {
+        if (!known_zero)
+          PAL::zero(p, size);
+      }
 
       return p;
     }
 
+    /**
+     * Zero free objects that are not known to be zero, until more than
+     * `max_bytes` would have been zeroed, and mark them as clean.  Returns
+     * the number of bytes zeroed.
+     */
+    template<SNMALLOC_CONCEPT(ConceptPAL) PAL>
+    size_t zero_free(size_t max_bytes)
+    {
+      size_t rsize = sizeclass_to_size(sizeclass);
+      size_t zeroed = 0;
+
+      for (size_t w = 0; w < BITMAP_WORDS; w++)
+      {
+        size_t dirty = free_objects[w] & ~(clean[w] | decommitted[w]);
+        while (dirty != 0)
+        {
+          if (zeroed + rsize > max_bytes)
+            return zeroed;
+
+          size_t bit = bits::ctz(dirty);
+          dirty &= dirty - 1;
+          PAL::zero(object_address((w * bits::BITS) + bit), rsize);
+          clean[w] |= bits::one_at_bit(bit);
+          zeroed += rsize;
+        }
+      }
+
+      return zeroed;
+    }
+
     bool dealloc(void* p)
     {
-      SNMALLOC_ASSERT(head > 0);
+      SNMALLOC_ASSERT(!empty());
 
       // Returns true if the Mediumslab was full before this deallocation.
       bool was_full = full();
       free++;
-      stack[--head] = pointer_to_index(p);
+      size_t index = object_index(p);
+      free_objects[index / bits::BITS] |= bits::one_at_bit(index % bits::BITS);
 
       return was_full;
     }
 
+    /**
+     * Decommit the interior of the free object `p`, until it is allocated
+     * again, and account for it in `memory_provider`.
+     */
+    template<typename MemoryProvider>
+    void decommit(void* p, MemoryProvider& memory_provider)
+    {
+      void* start = interior_start(p);
+      void* end = interior_end(p);
+      SNMALLOC_ASSERT(start < end);
+      size_t size = pointer_diff(start, end);
+      MemoryProvider::Pal::notify_not_using(start, size);
+      memory_provider.decommitted_bytes += size;
+      memory_provider.medium_decommitted_bytes += size;
+
+      size_t index = object_index(p);
+      decommitted[index / bits::BITS] |= bits::one_at_bit(index % bits::BITS);
+    }
+
+    /**
+     * Called before the slab is returned to the large allocator.  The
+     * interiors of free objects that were decommitted are no longer
+     * accounted for here, and with `recommit` they are recommitted, so that
+     * the whole slab can be reused as committed memory.
+     */
+    template<typename MemoryProvider>
+    void release_decommitted(MemoryProvider& memory_provider, bool recommit)
+    {
+      for (size_t w = 0; w < BITMAP_WORDS; w++)
+      {
+        while (decommitted[w] != 0)
+        {
+          size_t bit = bits::ctz(decommitted[w]);
+          decommitted[w] &= decommitted[w] - 1;
+
+          void* p = object_address((w * bits::BITS) + bit);
+          void* start = interior_start(p);
+          size_t size = pointer_diff(start, interior_end(p));
+          if (recommit)
+            MemoryProvider::Pal::template notify_using<NoZero>(start, size);
+          memory_provider.decommitted_bytes -= size;
+          memory_provider.medium_decommitted_bytes -= size;
+        }
+      }
+    }
+
     bool full()
     {
       return free == 0;
     }
 
+    /**
+     * The number of objects currently allocated from this slab.
+     */
+    size_t allocated_objects()
+    {
+      return medium_slab_free(sizeclass) - free;
+    }
+
     bool empty()
     {
-      return head == 0;
+      return free == medium_slab_free(sizeclass);
     }
 
   private:
-    uint16_t pointer_to_index(void* p)
+    /**
+     * The object numbered `index` from the start of the slab.  Objects are
+     * aligned to the end of the slab.
+     */
+    void* object_address(size_t index)
+    {
+      size_t from_end =
+        (medium_slab_free(sizeclass) - index) * sizeclass_to_size(sizeclass);
+      return pointer_offset(this, SUPERSLAB_SIZE - from_end);
+    }
+
+    size_t object_index(void* p)
+    {
+      // Use 32-bit division as considerably faster than 64-bit, and
+      // everything fits into 32bits here.
+      auto from_end = static_cast<uint32_t>(
+        pointer_diff(p, pointer_offset(this, SUPERSLAB_SIZE)));
+      return medium_slab_free(sizeclass) -
+        (from_end / static_cast<uint32_t>(sizeclass_to_size(sizeclass)));
+    }
+
+    /**
+     * Recommit the interior of the object `p`, which is being allocated, and
+     * with `YesZero` zero its first `size` bytes.
+     */
+    template<ZeroMem zero_mem, typename MemoryProvider>
+    void recommit(void* p, size_t size, MemoryProvider& memory_provider)
+    {
+      using PAL = typename MemoryProvider::Pal;
+      void* start = interior_start(p);
+      void* end = interior_end(p);
+      size_t interior = pointer_diff(start, end);
+      memory_provider.decommitted_bytes -= interior;
+      memory_provider.medium_decommitted_bytes -= interior;
+
+      // Passing zero_mem ensures the PAL provides zeroed pages if required,
+      // leaving only the partial pages at either end.
+      PAL::template notify_using<zero_mem>(start, interior);
+
+      if constexpr (zero_mem == YesZero)
+      {
+        PAL::zero(p, pointer_diff(p, start));
+        if (pointer_diff(p, end) < size)
+          PAL::zero(end, size - pointer_diff(p, end));
+      }
+      else
+        UNUSED(size);
+    }
+
+    /**
+     * The pages of the object `p` that it does not share with others.
+     */
+    void* interior_start(void* p)
+    {
+      return pointer_align_up<OS_PAGE_SIZE>(p);
+    }
+
+    void* interior_end(void* p)
+    {
+      return pointer_align_down<OS_PAGE_SIZE>(
+        pointer_offset(p, sizeclass_to_size(sizeclass)));
+    }
+
+    /**
+     * Clear the clean bit of the object at `index`, returning its old value.
+     */
+    bool take_clean(size_t index)
+    {
+      return take_bit(clean, index);
+    }
+
+    static bool take_bit(size_t (&bitmap)[BITMAP_WORDS], size_t index)
     {
-      // Get the offset from the slab for a memory location.
-      return static_cast<uint16_t>(pointer_diff(this, p) >> 8);
+      size_t bit = bits::one_at_bit(index % bits::BITS);
+      bool was_set = (bitmap[index / bits::BITS] & bit) != 0;
+      bitmap[index / bits::BITS] &= ~bit;
+      return was_set;
     }
   };
 } // namespace snmalloc
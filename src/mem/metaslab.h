@@ -114,6 +114,21 @@ namespace snmalloc
 #endif
     }
 
+    /**
+     * Clear what `store_next` wrote to `p`, leaving it as it was before if it
+     * was zero.
+     */
+    static SNMALLOC_FAST_PATH void clear_next(void* p)
+    {
+      *static_cast<void**>(p) = nullptr;
+#if defined(CHECK_CLIENT)
+      if constexpr (aal_supports<IntegerPointers>)
+      {
+        *(static_cast<uintptr_t*>(p) + 1) = 0;
+      }
+#endif
+    }
+
     /// Accessor function for the next pointer in a block.
     /// In Debug checks for simple corruptions.
     static SNMALLOC_FAST_PATH void* follow_next(void* node)
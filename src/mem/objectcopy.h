@@ -0,0 +1,78 @@
+#pragma once
+
+#include "../pal/pal.h"
+#include "mediumslab.h"
+#include "sizeclasstable.h"
+
+#include <string.h>
+#include <utility>
+
+namespace snmalloc
+{
+  /**
+   * Objects of up to this size are copied by code specialised for their
+   * sizeclass.  Above it, `memcpy` is already efficient.
+   */
+  static constexpr size_t MAX_FIXED_COPY_SIZE = 1024;
+
+  /**
+   * Copies of at least this size, that is of large objects, use streaming
+   * stores, as the destination is too large to be worth keeping in the
+   * cache.
+   */
+  static constexpr size_t STREAMING_COPY_SIZE = SUPERSLAB_SIZE;
+
+  static_assert(
+    MAX_FIXED_COPY_SIZE <= SLAB_SIZE,
+    "Fixed size copies are only for small sizeclasses");
+
+  using FixedCopy = void (*)(void*, const void*);
+
+  /**
+   * Copy `size` bytes, which the compiler turns into a fixed sequence of
+   * vector loads and stores.
+   */
+  template<size_t size>
+  void copy_fixed(void* dst, const void* src)
+  {
+    memcpy(dst, src, size);
+  }
+
+  template<typename Indices>
+  struct FixedCopyTable;
+
+  template<size_t... sizeclass>
+  struct FixedCopyTable<std::index_sequence<sizeclass...>>
+  {
+    static constexpr FixedCopy copies[] = {
+      &copy_fixed<sizeclass_to_size(sizeclass)>...};
+  };
+
+  /**
+   * The fixed size copy for each sizeclass up to `MAX_FIXED_COPY_SIZE`.
+   */
+  using FixedCopies = FixedCopyTable<std::make_index_sequence<
+    size_to_sizeclass_const(MAX_FIXED_COPY_SIZE) + 1>>;
+
+  /**
+   * Copy at least `size` bytes from the start of the object `src` to the
+   * start of the object `dst`, as `realloc` does when it moves an object.
+   * Both objects must be at least `round_size(size)` bytes, as this may
+   * copy up to that many, so that small copies can use code fixed for their
+   * sizeclass.
+   */
+  inline void copy_object(void* dst, const void* src, size_t size)
+  {
+    if (size <= MAX_FIXED_COPY_SIZE)
+    {
+      if (size != 0)
+        FixedCopies::copies[size_to_sizeclass(size)](dst, src);
+      return;
+    }
+
+    if (size >= STREAMING_COPY_SIZE)
+      Aal::copy_streaming(dst, src, size);
+    else
+      memcpy(dst, src, size);
+  }
+} // namespace snmalloc
@@ -82,6 +82,16 @@ namespace snmalloc
       stack.push(p);
     }
 
+    /**
+     * Take a single object previously released to the pool, without marking
+     * it as in use.  Returns nullptr if there are none.  The object must be
+     * either returned with `restore`, or marked as in use with `set_in_use`.
+     */
+    T* extract_one()
+    {
+      return stack.pop();
+    }
+
     T* extract(T* p = nullptr)
     {
       // Returns a linked list of all objects in the stack, emptying the stack.
@@ -17,26 +17,33 @@ namespace snmalloc
     std::atomic<T*> next{nullptr};
     /// Used by the pool to keep the list of all entries ever created.
     T* list_next;
-    std::atomic_flag in_use = ATOMIC_FLAG_INIT;
+    std::atomic<bool> in_use{false};
 
   public:
     void set_in_use()
     {
-      if (in_use.test_and_set())
+      if (in_use.exchange(true))
         error("Critical error: double use of Pooled Type!");
     }
 
     void reset_in_use()
     {
-      in_use.clear();
+      in_use.store(false);
+    }
+
+    /**
+     * Returns true if this object has been acquired from the pool and not yet
+     * released.  This does not modify the flag, so it is safe to call while
+     * another thread is acquiring the object.
+     */
+    bool is_in_use()
+    {
+      return in_use.load();
     }
 
     bool debug_is_in_use()
     {
-      bool result = in_use.test_and_set();
-      if (!result)
-        in_use.clear();
-      return result;
+      return is_in_use();
     }
   };
 } // namespace snmalloc
\ No newline at end of file
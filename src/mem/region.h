@@ -0,0 +1,221 @@
+#pragma once
+
+#include "../ds/address.h"
+#include "../pal/pal.h"
+#include "alloc.h"
+#include "largealloc.h"
+
+#include <new>
+#include <string.h>
+
+namespace snmalloc
+{
+  /**
+   * A PAL that defers to `PAL` for everything except obtaining and returning
+   * memory.  It never reserves address space, so a memory provider using it
+   * only hands out memory it has been given with `add_range`, and it never
+   * decommits or remaps memory, which belongs to the caller and may be a
+   * shared or huge page mapping.
+   */
+  template<SNMALLOC_CONCEPT(ConceptPAL) PAL>
+  class PALFixedRange : public PAL
+  {
+  public:
+    /**
+     * Aligned allocation would bypass the address space manager.
+     */
+    static constexpr uint64_t pal_features =
+      PAL::pal_features & ~static_cast<uint64_t>(AlignedAllocation);
+
+    static std::pair<void*, size_t> reserve_at_least(size_t size) noexcept
+    {
+      UNUSED(size);
+      return {nullptr, 0};
+    }
+
+    static void notify_not_using(void* p, size_t size) noexcept
+    {
+      UNUSED(p);
+      UNUSED(size);
+    }
+
+    template<ZeroMem zero_mem>
+    static void notify_using(void* p, size_t size) noexcept
+    {
+      if constexpr (zero_mem == YesZero)
+        zero<true>(p, size);
+      else
+      {
+        UNUSED(p);
+        UNUSED(size);
+      }
+    }
+
+    template<bool page_aligned = false>
+    static void zero(void* p, size_t size) noexcept
+    {
+      memset(p, 0, size);
+    }
+  };
+
+  inline bool region_needs_initialisation(void*)
+  {
+    return false;
+  }
+
+  inline void* region_init_allocator(function_ref<void*(void*)>)
+  {
+    return nullptr;
+  }
+
+  /**
+   * An allocator that serves objects from a buffer supplied by the caller,
+   * for example a huge page or shared memory mapping, with the usual
+   * sizeclasses and fast paths.  `reset` forgets every allocation at once,
+   * which makes regions suitable as per-request scratch arenas.
+   *
+   * A region must be used by one thread at a time.  Its objects must be
+   * freed through the region, if at all; none may be freed or used after
+   * `reset`, or after the region is destroyed.  Allocations fail, returning
+   * nullptr, once the buffer is exhausted.  The region's metadata, including
+   * the header of every chunk, is kept in the buffer, so usable space is
+   * somewhat less than its size.
+   */
+  template<SNMALLOC_CONCEPT(ConceptPAL) PAL = Pal>
+  class Region
+  {
+  public:
+    using Provider = MemoryProviderStateMixin<PALFixedRange<PAL>>;
+    using RegionAlloc = Allocator<
+      region_needs_initialisation,
+      region_init_allocator,
+      Provider,
+      SNMALLOC_DEFAULT_CHUNKMAP,
+      true>;
+
+  private:
+    using ChunkMap = SNMALLOC_DEFAULT_CHUNKMAP;
+
+    void* base;
+    size_t length;
+
+    /**
+     * The chunk aligned part of the buffer, and the pagemap entries its
+     * chunks had before the region was created, kept at the start of the
+     * buffer.  The buffer may be part of another allocation, such as a large
+     * allocation from the global allocator, whose entries the region must
+     * not lose.
+     */
+    void* chunks;
+    size_t chunk_count;
+    uint8_t* saved_entries;
+
+    alignas(Provider) char provider_storage[sizeof(Provider)];
+    alignas(RegionAlloc) char alloc_storage[sizeof(RegionAlloc)];
+
+    /**
+     * Set up a provider that hands out the whole buffer, and an allocator
+     * that uses it.  This does not depend on what was allocated before.
+     */
+    void init()
+    {
+      Provider* p = new (provider_storage) Provider();
+      p->decommit_policy = DecommitNone;
+      p->dirty_address_space = true;
+      p->add_range(base, length);
+
+      new (alloc_storage) RegionAlloc(*p);
+    }
+
+    void destroy()
+    {
+      allocator()->~RegionAlloc();
+      memory_provider().~Provider();
+
+      // The allocator and provider share the pagemap with the rest of the
+      // process, so put back the entries of the chunks in the buffer.
+      for (size_t i = 0; i < chunk_count; i++)
+      {
+        ChunkMap::restore(
+          pointer_offset(chunks, i << SUPERSLAB_BITS), saved_entries[i]);
+      }
+    }
+
+  public:
+    /**
+     * Create a region over the `size` bytes from `buffer`.  The buffer must
+     * stay mapped, read-write, until the region is destroyed, and must hold
+     * at least a few chunks, as the allocator takes one as it starts.
+     */
+    Region(void* buffer, size_t size)
+    {
+      base = pointer_align_up<OS_PAGE_SIZE>(buffer);
+      size_t skipped = pointer_diff(buffer, base);
+      length =
+        size > skipped ? bits::align_down(size - skipped, OS_PAGE_SIZE) : 0;
+
+      chunks = pointer_align_up(base, SUPERSLAB_SIZE);
+      void* end =
+        pointer_align_down(pointer_offset(base, length), SUPERSLAB_SIZE);
+      chunk_count =
+        chunks < end ? (pointer_diff(chunks, end) >> SUPERSLAB_BITS) : 0;
+
+      saved_entries = static_cast<uint8_t*>(base);
+      for (size_t i = 0; i < chunk_count; i++)
+        saved_entries[i] =
+          ChunkMap::get(pointer_offset(chunks, i << SUPERSLAB_BITS));
+
+      size_t reserved = bits::align_up(chunk_count, OS_PAGE_SIZE);
+      base = pointer_offset(base, reserved);
+      length -= reserved;
+      init();
+    }
+
+    Region(const Region&) = delete;
+    Region& operator=(const Region&) = delete;
+
+    ~Region()
+    {
+      destroy();
+    }
+
+    /**
+     * The memory provider that hands out the buffer, for its usage counters.
+     */
+    Provider& memory_provider()
+    {
+      return *reinterpret_cast<Provider*>(provider_storage);
+    }
+
+    /**
+     * The allocator serving this region, for access to the full `Allocator`
+     * interface.
+     */
+    RegionAlloc* allocator()
+    {
+      return reinterpret_cast<RegionAlloc*>(alloc_storage);
+    }
+
+    SNMALLOC_FAST_PATH ALLOCATOR void* alloc(size_t size)
+    {
+      return allocator()->alloc(size);
+    }
+
+    SNMALLOC_FAST_PATH void dealloc(void* p)
+    {
+      allocator()->dealloc(p);
+    }
+
+    /**
+     * Forget every allocation and start again with the whole buffer free.
+     * No objects are visited: the address space is rewound and a new
+     * allocator is started, so this takes time proportional to the size of
+     * the buffer in chunks, to restore their pagemap entries.
+     */
+    void reset()
+    {
+      destroy();
+      init();
+    }
+  };
+} // namespace snmalloc
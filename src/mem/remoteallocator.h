@@ -39,6 +39,29 @@ namespace snmalloc
     sizeof(Remote) <= MIN_ALLOC_SIZE,
     "Needs to be able to fit in smallest allocation.");
 
+  /*
+   * A run of objects from a single slab, pre-linked by the sender so that the
+   * receiver can splice the whole run onto the slab's free list in one step.
+   *
+   * The header is the first object that was added to the run, and is also the
+   * tail of the embedded free list.  `chain_head` is the most recently added
+   * object, and each object's free list next pointer leads towards the
+   * header.  A run of a single object has `chain_head` equal to the header.
+   */
+  struct RemoteChain : public Remote
+  {
+    void* chain_head;
+    size_t chain_length;
+  };
+
+  /**
+   * The number of bytes of remote deallocations an allocator caches before
+   * sending them to their owners.  Starts as `REMOTE_CACHE` and can be
+   * changed at runtime; each allocator picks up the new value the next time
+   * it posts its cache.
+   */
+  inline std::atomic<int64_t> remote_cache_budget{REMOTE_CACHE};
+
   struct RemoteAllocator
   {
     using alloc_id_t = Remote::alloc_id_t;
@@ -46,6 +69,29 @@ namespace snmalloc
     // is read by other threads.
     alignas(CACHELINE_SIZE) MPSCQ<Remote> message_queue;
 
+    /**
+     * Approximate number of bytes of deallocations waiting in the message
+     * queue.  Senders add to this before enqueuing, and the owner subtracts
+     * once it has processed the messages.
+     */
+    std::atomic<size_t> queued_bytes{0};
+
+    /**
+     * Account for `bytes` of deallocations about to be enqueued.  Returns true
+     * if this takes the queue over `REMOTE_QUEUE_THRESHOLD`.
+     */
+    bool add_queued_bytes(size_t bytes)
+    {
+      size_t before = queued_bytes.fetch_add(bytes, std::memory_order_relaxed);
+      return (before < REMOTE_QUEUE_THRESHOLD) &&
+        ((before + bytes) >= REMOTE_QUEUE_THRESHOLD);
+    }
+
+    void remove_queued_bytes(size_t bytes)
+    {
+      queued_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+
     alloc_id_t id()
     {
       return static_cast<alloc_id_t>(
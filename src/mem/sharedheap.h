@@ -0,0 +1,266 @@
+#pragma once
+
+#include "../ds/address.h"
+#include "../pal/pal.h"
+#include "alloc.h"
+#include "pool.h"
+#include "region.h"
+
+#include <new>
+
+namespace snmalloc
+{
+  /**
+   * A pagemap covering only the range of a shared heap.  Its entries are
+   * kept in the heap, so every process sees the same chunks, and addresses
+   * outside the range are never the heap's.
+   */
+  class SharedPagemap
+  {
+    uintptr_t base;
+    size_t count;
+    std::atomic<uint8_t>* entries;
+
+    size_t index(uintptr_t p)
+    {
+      // Addresses below `base` wrap to indices beyond `count`.
+      return (p - base) >> SUPERSLAB_BITS;
+    }
+
+  public:
+    void init(void* heap, size_t size, std::atomic<uint8_t>* storage)
+    {
+      base = address_cast(heap);
+      count = size >> SUPERSLAB_BITS;
+      entries = storage;
+    }
+
+    uint8_t get(uintptr_t p)
+    {
+      size_t i = index(p);
+      if (i >= count)
+        return CMNotOurs;
+      return entries[i].load(std::memory_order_relaxed);
+    }
+
+    void set(uintptr_t p, uint8_t x)
+    {
+      SNMALLOC_ASSERT(index(p) < count);
+      entries[index(p)].store(x, std::memory_order_relaxed);
+    }
+
+    void set_range(uintptr_t p, uint8_t x, size_t length)
+    {
+      SNMALLOC_ASSERT(index(p) + length <= count);
+      for (size_t i = index(p); length > 0; i++, length--)
+        entries[i].store(x, std::memory_order_relaxed);
+    }
+  };
+
+  /**
+   * Gives the allocators of a shared heap access to its pagemap.  There is
+   * one for each process, so a process can be attached to one shared heap
+   * at a time.
+   */
+  struct SharedPagemapProvider
+  {
+    inline static SharedPagemap* current = nullptr;
+
+    /**
+     * Set while this process is creating, or attached to, a shared heap.
+     */
+    inline static std::atomic<bool> in_use{false};
+
+    static SharedPagemap& pagemap()
+    {
+      return *current;
+    }
+
+    /**
+     * Reserve the pagemap for a shared heap.  Returns false if this process
+     * is already using one.
+     */
+    static bool claim()
+    {
+      return !in_use.exchange(true, std::memory_order_acquire);
+    }
+
+    static void release()
+    {
+      current = nullptr;
+      in_use.store(false, std::memory_order_release);
+    }
+  };
+
+  /**
+   * A heap shared by several processes, which can allocate from it and free
+   * each other's objects, so that pointers to its objects can be passed
+   * between them.
+   *
+   * The heap is a shared memory object that is mapped at the same address
+   * in every process.  Everything that allocators share is kept inside it:
+   * the memory provider, the pool of allocators, a pagemap covering only the
+   * heap, and the allocators themselves, whose message queues therefore
+   * work across processes.  This relies on the atomic operations used being
+   * lock-free.
+   *
+   * Each process that uses the heap acquires its own allocators from it.
+   * Objects in the heap must be freed by one of the heap's allocators.
+   */
+  template<SNMALLOC_CONCEPT(ConceptPAL) PAL = Pal>
+  class SharedHeap
+  {
+  public:
+    using Provider = MemoryProviderStateMixin<PALFixedRange<PAL>>;
+    using SharedAlloc = Allocator<
+      region_needs_initialisation,
+      region_init_allocator,
+      Provider,
+      DefaultChunkMap<SharedPagemapProvider>,
+      true>;
+
+  private:
+    static constexpr uint64_t MAGIC = 0x736e6d616c6c6f63;
+
+    /**
+     * Set once the heap is ready to be attached to.  This and the next two
+     * fields are read from the first page of the heap by `attach`.
+     */
+    std::atomic<uint64_t> magic;
+    void* base;
+    size_t size;
+
+    SharedPagemap chunkmap;
+    Pool<SharedAlloc, Provider>* pool;
+    Provider provider;
+
+    SharedHeap() = default;
+
+    /**
+     * Map the shared heap `fd` at the address it was created at.
+     */
+    static SharedHeap* map(int fd)
+    {
+      auto* header = static_cast<SharedHeap*>(
+        PAL::map_shared_at(fd, nullptr, OS_PAGE_SIZE));
+      if (header == nullptr)
+        return nullptr;
+
+      bool valid = header->magic.load(std::memory_order_acquire) == MAGIC;
+      void* address = header->base;
+      size_t length = header->size;
+      PAL::unmap_shared(header, OS_PAGE_SIZE);
+      if (!valid)
+        return nullptr;
+
+      return static_cast<SharedHeap*>(PAL::map_shared_at(fd, address, length));
+    }
+
+  public:
+    /**
+     * Create a shared heap of at least `size` bytes and attach this process
+     * to it.  Other processes attach with the file descriptor returned in
+     * `fd`, either inherited across `fork` or passed over a socket.  The
+     * descriptor is closed on `exec`, so a process that starts another
+     * program to attach must first clear its `FD_CLOEXEC` flag.  Returns
+     * nullptr on failure, or if this process already uses a shared heap.
+     */
+    static SharedHeap* create(size_t size, int* fd)
+    {
+      if (!SharedPagemapProvider::claim())
+        return nullptr;
+
+      size = bits::align_up(size, SUPERSLAB_SIZE);
+      auto mapping = PAL::map_shared(size, SUPERSLAB_SIZE);
+      if (mapping.first == nullptr)
+      {
+        SharedPagemapProvider::release();
+        return nullptr;
+      }
+
+      // The shared memory object starts zeroed.
+      SharedHeap* heap = new (mapping.first) SharedHeap();
+      heap->base = mapping.first;
+      heap->size = size;
+
+      size_t count = size >> SUPERSLAB_BITS;
+      heap->chunkmap.init(
+        heap,
+        size,
+        reinterpret_cast<std::atomic<uint8_t>*>(
+          pointer_offset(heap, sizeof(SharedHeap))));
+
+      // The rest of the first chunk is used for metadata, such as the
+      // allocators.
+      size_t header = bits::align_up(sizeof(SharedHeap) + count, OS_PAGE_SIZE);
+      heap->provider.decommit_policy = DecommitNone;
+      heap->provider.add_range(pointer_offset(heap, header), size - header);
+
+      heap->pool = Pool<SharedAlloc, Provider>::make(heap->provider);
+      if (heap->pool == nullptr)
+        error("Shared heap is too small");
+
+      SharedPagemapProvider::current = &heap->chunkmap;
+      heap->magic.store(MAGIC, std::memory_order_release);
+      *fd = mapping.second;
+      return heap;
+    }
+
+    /**
+     * Attach this process to the shared heap `fd`, which is mapped at the
+     * same address as in the process that created it.  Returns nullptr if
+     * that address is in use, `fd` is not a shared heap, or this process
+     * already uses a shared heap.
+     */
+    static SharedHeap* attach(int fd)
+    {
+      if (!SharedPagemapProvider::claim())
+        return nullptr;
+
+      SharedHeap* heap = map(fd);
+      if (heap == nullptr)
+      {
+        SharedPagemapProvider::release();
+        return nullptr;
+      }
+
+      SharedPagemapProvider::current = &heap->chunkmap;
+      return heap;
+    }
+
+    /**
+     * Unmap the heap from this process.  Every allocator this process
+     * acquired must have been released, and none of the heap's objects may
+     * be used by this process afterwards.
+     */
+    void detach()
+    {
+      PAL::unmap_shared(this, size);
+      SharedPagemapProvider::release();
+    }
+
+    /**
+     * Acquire an allocator for the calling thread.  Like other allocators,
+     * it must be used by one thread at a time.
+     */
+    SharedAlloc* acquire()
+    {
+      return pool->acquire(provider);
+    }
+
+    /**
+     * Return an allocator to the heap, where another thread or process may
+     * acquire it.  Its objects remain valid.
+     */
+    void release(SharedAlloc* a)
+    {
+      a->flush_remote();
+      pool->release(a);
+    }
+
+    Provider& memory_provider()
+    {
+      return provider;
+    }
+  };
+} // namespace snmalloc
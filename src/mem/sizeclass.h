@@ -2,6 +2,7 @@
 
 #include "../pal/pal.h"
 #include "allocconfig.h"
+#include "sizeclassprofile.h"
 
 namespace snmalloc
 {
@@ -25,8 +26,11 @@ namespace snmalloc
     // Don't use sizeclasses that are not a multiple of the alignment.
     // For example, 24 byte allocations can be
     // problematic for some data due to alignment issues.
+    // Sizeclasses added for the profile come before the default sizeclasses
+    // larger than them.
     auto sc = static_cast<sizeclass_t>(
-      bits::to_exp_mant_const<INTERMEDIATE_BITS, MIN_ALLOC_BITS>(size));
+      bits::to_exp_mant_const<INTERMEDIATE_BITS, MIN_ALLOC_BITS>(size) +
+      profile_sizeclasses.count_below(size));
 
     SNMALLOC_ASSERT(sc == static_cast<uint8_t>(sc));
 
@@ -65,13 +69,14 @@ namespace snmalloc
     size_t align = bits::ctz(rsize);
     size_t divider = rsize >> align;
     // Maximum of 24 bits for 16MiB super/medium slab
-    if (INTERMEDIATE_BITS == 0 || divider == 1)
+    if ((INTERMEDIATE_BITS == 0 && NUM_PROFILE_CLASSES == 0) || divider == 1)
     {
       SNMALLOC_ASSERT(divider == 1);
       return offset & ~(rsize - 1);
     }
 
-    if constexpr (bits::is64() && INTERMEDIATE_BITS <= 2)
+    if constexpr (
+      bits::is64() && INTERMEDIATE_BITS <= 2 && NUM_PROFILE_CLASSES == 0)
     {
       // Only works for 64 bit multiplication, as the following will overflow in
       // 32bit.
@@ -109,13 +114,14 @@ namespace snmalloc
     size_t align = bits::ctz(rsize);
     size_t divider = rsize >> align;
     // Maximum of 24 bits for 16MiB super/medium slab
-    if (INTERMEDIATE_BITS == 0 || divider == 1)
+    if ((INTERMEDIATE_BITS == 0 && NUM_PROFILE_CLASSES == 0) || divider == 1)
     {
       SNMALLOC_ASSERT(divider == 1);
       return (offset & (rsize - 1)) == 0;
     }
 
-    if constexpr (bits::is64() && INTERMEDIATE_BITS <= 2)
+    if constexpr (
+      bits::is64() && INTERMEDIATE_BITS <= 2 && NUM_PROFILE_CLASSES == 0)
     {
       // Only works for 64 bit multiplication, as the following will overflow in
       // 32bit.
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "allocconfig.h"
+
+namespace snmalloc
+{
+  /**
+   * The number of requests of up to `size` bytes in an allocation profile.
+   */
+  struct SizeProfileEntry
+  {
+    size_t size;
+    size_t count;
+  };
+
+  /**
+   * The allocation size profile that the small sizeclasses are tuned for.
+   * `SNMALLOC_SIZECLASS_PROFILE` names a file of `{size, count},` entries,
+   * for example the `high` and `count` columns of the `AllocSizes` rows
+   * printed by `AllocStats`.  The final entry only terminates the list.
+   */
+  static constexpr SizeProfileEntry sizeclass_profile[] = {
+#ifdef SNMALLOC_SIZECLASS_PROFILE
+#  include SNMALLOC_SIZECLASS_PROFILE
+#endif
+    {0, 0}};
+
+  /**
+   * The small sizeclasses added to the default ladder for
+   * `sizeclass_profile`, in increasing order.
+   *
+   * They are chosen greedily: each round adds the size that most reduces
+   * the bytes wasted by rounding the profiled requests up, until
+   * `MAX_PROFILE_SIZECLASSES` have been added or no size helps.  A size is
+   * only added if rounding an aligned request up to it cannot lose the
+   * alignment, that is, if every multiple of a larger power of two below it
+   * is already rounded to a smaller sizeclass.
+   */
+  struct ProfileSizeclasses
+  {
+    size_t sizes[MAX_PROFILE_SIZECLASSES + 1] = {};
+    size_t count = 0;
+
+    constexpr ProfileSizeclasses()
+    {
+      while (count < MAX_PROFILE_SIZECLASSES)
+      {
+        size_t best = 0;
+        size_t best_saving = 0;
+
+        for (auto& entry : sizeclass_profile)
+        {
+          if (entry.size == 0)
+            continue;
+
+          size_t candidate = bits::align_up(entry.size, MIN_ALLOC_SIZE);
+          if (candidate > SLAB_SIZE)
+            continue;
+
+          size_t next = next_class(candidate);
+          size_t prev = prev_class(candidate);
+          if (next == candidate)
+            continue;
+
+          size_t low_bit = candidate & (~candidate + 1);
+          if ((candidate - low_bit) > prev)
+            continue;
+
+          size_t saving = 0;
+          for (auto& e : sizeclass_profile)
+          {
+            if ((e.size > prev) && (e.size <= candidate))
+              saving += e.count * (next - candidate);
+          }
+
+          if (saving > best_saving)
+          {
+            best = candidate;
+            best_saving = saving;
+          }
+        }
+
+        if (best == 0)
+          break;
+
+        size_t i = count++;
+        for (; (i > 0) && (sizes[i - 1] > best); i--)
+          sizes[i] = sizes[i - 1];
+        sizes[i] = best;
+      }
+    }
+
+    /**
+     * The number of added sizeclasses smaller than `size`.
+     */
+    constexpr size_t count_below(size_t size) const
+    {
+      size_t n = 0;
+      while ((n < count) && (sizes[n] < size))
+        n++;
+      return n;
+    }
+
+  private:
+    static constexpr size_t default_class(size_t sc)
+    {
+      return bits::from_exp_mant<INTERMEDIATE_BITS, MIN_ALLOC_BITS>(sc);
+    }
+
+    /**
+     * The smallest sizeclass of at least `size` bytes.
+     */
+    constexpr size_t next_class(size_t size) const
+    {
+      size_t result = default_class(
+        bits::to_exp_mant_const<INTERMEDIATE_BITS, MIN_ALLOC_BITS>(size));
+      for (size_t i = 0; i < count; i++)
+      {
+        if ((sizes[i] >= size) && (sizes[i] < result))
+          result = sizes[i];
+      }
+      return result;
+    }
+
+    /**
+     * The largest sizeclass smaller than `size` bytes, or zero.
+     */
+    constexpr size_t prev_class(size_t size) const
+    {
+      size_t sc =
+        bits::to_exp_mant_const<INTERMEDIATE_BITS, MIN_ALLOC_BITS>(size);
+      size_t result = (sc == 0) ? 0 : default_class(sc - 1);
+      for (size_t i = 0; i < count; i++)
+      {
+        if ((sizes[i] < size) && (sizes[i] > result))
+          result = sizes[i];
+      }
+      return result;
+    }
+  };
+
+  static constexpr ProfileSizeclasses profile_sizeclasses =
+    ProfileSizeclasses();
+
+  static constexpr size_t NUM_PROFILE_CLASSES = profile_sizeclasses.count;
+} // namespace snmalloc
@@ -7,6 +7,19 @@ namespace snmalloc
 {
   constexpr size_t PTR_BITS = bits::next_pow2_bits_const(sizeof(void*));
 
+  // Sizes up to this are mapped to a sizeclass by table lookup.
+  constexpr size_t SIZECLASS_LOOKUP_MAX =
+    bits::max(SLAB_SIZE, SIZECLASS_LOOKUP_LIMIT);
+
+  // A table covering medium sizes as well has an entry for every
+  // MIN_ALLOC_SIZE bytes, each a byte, so that it takes as much space as a
+  // table of just the small sizes.
+  constexpr bool SIZECLASS_LOOKUP_MEDIUM = SIZECLASS_LOOKUP_MAX > SLAB_SIZE;
+  constexpr size_t SIZECLASS_LOOKUP_BITS =
+    SIZECLASS_LOOKUP_MEDIUM ? MIN_ALLOC_BITS : PTR_BITS;
+  using sizeclass_lookup_t = std::
+    conditional_t<SIZECLASS_LOOKUP_MEDIUM, sizeclass_compress_t, sizeclass_t>;
+
   constexpr static SNMALLOC_PURE size_t sizeclass_lookup_index(const size_t s)
   {
     // We subtract and shirt to reduce the size of the table, i.e. we don't have
@@ -14,16 +27,17 @@ namespace snmalloc
     // We could shift by MIN_ALLOC_BITS, as this would give us the most
     // compressed table, but by shifting by PTR_BITS the code-gen is better
     // as the most important path using this subsequently shifts left by
-    // PTR_BITS, hence they can be fused into a single mask.
-    return (s - 1) >> PTR_BITS;
+    // PTR_BITS, hence they can be fused into a single mask.  That does not
+    // apply to the byte entries of a table covering medium sizes.
+    return (s - 1) >> SIZECLASS_LOOKUP_BITS;
   }
 
   constexpr static size_t sizeclass_lookup_size =
-    sizeclass_lookup_index(SLAB_SIZE + 1);
+    sizeclass_lookup_index(SIZECLASS_LOOKUP_MAX + 1);
 
   struct SizeClassTable
   {
-    sizeclass_t sizeclass_lookup[sizeclass_lookup_size] = {{}};
+    sizeclass_lookup_t sizeclass_lookup[sizeclass_lookup_size] = {{}};
     ModArray<NUM_SIZECLASSES, size_t> size;
     ModArray<NUM_SIZECLASSES, size_t> cache_friendly_mask;
     ModArray<NUM_SIZECLASSES, size_t> inverse_cache_friendly_mask;
@@ -40,16 +54,25 @@ namespace snmalloc
       medium_slab_slots()
     {
       size_t curr = 1;
+      size_t profile_class = 0;
       for (sizeclass_t sizeclass = 0; sizeclass < NUM_SIZECLASSES; sizeclass++)
       {
+        // Merge the sizeclasses added for the profile into the default ones.
         size[sizeclass] =
-          bits::from_exp_mant<INTERMEDIATE_BITS, MIN_ALLOC_BITS>(sizeclass);
-        if (sizeclass < NUM_SMALL_CLASSES)
+          bits::from_exp_mant<INTERMEDIATE_BITS, MIN_ALLOC_BITS>(
+            sizeclass - profile_class);
+        if (
+          (profile_class < NUM_PROFILE_CLASSES) &&
+          (profile_sizeclasses.sizes[profile_class] < size[sizeclass]))
+        {
+          size[sizeclass] = profile_sizeclasses.sizes[profile_class++];
+        }
+
+        for (; (curr <= size[sizeclass]) && (curr <= SIZECLASS_LOOKUP_MAX);
+             curr += 1 << SIZECLASS_LOOKUP_BITS)
         {
-          for (; curr <= size[sizeclass]; curr += 1 << PTR_BITS)
-          {
-            sizeclass_lookup[sizeclass_lookup_index(curr)] = sizeclass;
-          }
+          sizeclass_lookup[sizeclass_lookup_index(curr)] =
+            static_cast<sizeclass_lookup_t>(sizeclass);
         }
 
         size_t alignment = bits::min(
@@ -112,10 +135,10 @@ namespace snmalloc
 
   static inline sizeclass_t size_to_sizeclass(size_t size)
   {
-    if ((size - 1) <= (SLAB_SIZE - 1))
+    if ((size - 1) <= (SIZECLASS_LOOKUP_MAX - 1))
     {
       auto index = sizeclass_lookup_index(size);
-      SNMALLOC_ASSUME(index <= sizeclass_lookup_index(SLAB_SIZE));
+      SNMALLOC_ASSUME(index <= sizeclass_lookup_index(SIZECLASS_LOOKUP_MAX));
       return sizeclass_metadata.sizeclass_lookup[index];
     }
 
@@ -123,7 +146,8 @@ namespace snmalloc
     // For example, 24 byte allocations can be
     // problematic for some data due to alignment issues.
     return static_cast<sizeclass_t>(
-      bits::to_exp_mant<INTERMEDIATE_BITS, MIN_ALLOC_BITS>(size));
+      bits::to_exp_mant<INTERMEDIATE_BITS, MIN_ALLOC_BITS>(size) +
+      NUM_PROFILE_CLASSES);
   }
 
   constexpr static inline uint16_t medium_slab_free(sizeclass_t sizeclass)
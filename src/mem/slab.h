@@ -86,12 +86,19 @@ namespace snmalloc
      * Given a bumpptr and a fast_free_list head reference, builds a new free
      * list, and stores it in the fast_free_list. It will only create a page
      * worth of allocations, or one if the allocation size is larger than a
-     * page.
+     * page.  Returns the number of objects in the new list.
      */
-    static SNMALLOC_FAST_PATH void
+    static SNMALLOC_FAST_PATH size_t
     alloc_new_list(void*& bumpptr, FreeListHead& fast_free_list, size_t rsize)
     {
+      if constexpr (FREE_LIST_SPREAD != 0)
+      {
+        if (rsize < FREE_LIST_SPREAD)
+          return alloc_new_list_spread(bumpptr, fast_free_list, rsize);
+      }
+
       fast_free_list.value = bumpptr;
+      size_t count = 1;
       void* newbumpptr = pointer_offset(bumpptr, rsize);
       void* slab_end = pointer_align_up<SLAB_SIZE>(newbumpptr);
       void* slab_end2 =
@@ -104,10 +111,64 @@ namespace snmalloc
         Metaslab::store_next(bumpptr, newbumpptr);
         bumpptr = newbumpptr;
         newbumpptr = pointer_offset(bumpptr, rsize);
+        count++;
       }
 
       Metaslab::store_next(bumpptr, nullptr);
       bumpptr = newbumpptr;
+      return count;
+    }
+
+    /**
+     * As `alloc_new_list`, but orders the list so that consecutive objects
+     * are at least `FREE_LIST_SPREAD` bytes apart.  The objects are taken in
+     * several passes, each taking every `stride`th object, from the highest
+     * down, from a different starting point.  A pass then ends near the
+     * start of the list and the next one begins near its end, which are at
+     * least `stride` objects apart if the list has at least three times
+     * `stride` objects.  A list is extended to the end of the slab rather
+     * than leave fewer than that behind, so only a slab too small to hold
+     * that many objects yields a list without the property.  The last
+     * object of a list is also far from the first of the next.
+     */
+    static SNMALLOC_SLOW_PATH size_t alloc_new_list_spread(
+      void*& bumpptr, FreeListHead& fast_free_list, size_t rsize)
+    {
+      void* slab_end = pointer_align_up<SLAB_SIZE>(pointer_offset(bumpptr, 1));
+      void* list_end =
+        pointer_align_up<OS_PAGE_SIZE>(pointer_offset(bumpptr, rsize * 32));
+      if (slab_end < list_end)
+        list_end = slab_end;
+
+      size_t stride = (FREE_LIST_SPREAD + rsize - 1) / rsize;
+      size_t count = (pointer_diff(bumpptr, list_end) + rsize - 1) / rsize;
+      size_t left = (pointer_diff(bumpptr, slab_end) + rsize - 1) / rsize;
+      if (left < count + 3 * stride)
+        count = left;
+
+      void* prev = nullptr;
+      for (size_t start = 0; (start < stride) && (start < count); start++)
+      {
+        // The highest index of the form start + k * stride below count.
+        size_t i = count - 1 - ((count - 1 - start) % stride);
+        while (true)
+        {
+          void* curr = pointer_offset(bumpptr, i * rsize);
+          if (prev == nullptr)
+            fast_free_list.value = curr;
+          else
+            Metaslab::store_next(prev, curr);
+          prev = curr;
+
+          if (i < stride)
+            break;
+          i -= stride;
+        }
+      }
+
+      Metaslab::store_next(prev, nullptr);
+      bumpptr = pointer_offset(bumpptr, count * rsize);
+      return count;
     }
 
     bool is_start_of_object(Superslab* super, void* p)
@@ -145,6 +206,34 @@ namespace snmalloc
       return true;
     }
 
+    /**
+     * Splices a pre-linked run of `length` objects, from `head` through to
+     * `tail`, onto the free list.  Returns false without modifying the slab if
+     * this would change the status of the slab, in which case the objects
+     * must be returned individually.
+     */
+    SNMALLOC_FAST_PATH bool
+    dealloc_chain_fast(Superslab* super, void* head, void* tail, size_t length)
+    {
+      Metaslab& meta = super->get_meta(this);
+#ifdef CHECK_CLIENT
+      if (meta.is_unused())
+        error("Detected potential double free.");
+#endif
+
+      // A full slab has needed == 1, so this also catches that case.
+      if (unlikely(meta.needed <= length))
+        return false;
+
+      meta.needed = static_cast<uint16_t>(meta.needed - length);
+
+      Metaslab::store_next(tail, meta.head);
+      meta.head = head;
+      SNMALLOC_ASSERT(meta.valid_head());
+
+      return true;
+    }
+
     // If dealloc fast returns false, then call this.
     // This does not need to remove the "use" as done by the fast path.
     // Returns a complex return code for managing the superslab meta data.
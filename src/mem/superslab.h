@@ -39,6 +39,15 @@ namespace snmalloc
     // short slab would be 6 + 1 = 7
     uint16_t used;
 
+    // The first slab, other than the short slab, that has not been handed
+    // out since this superslab was fresh, so is still zero.  Slabs are first
+    // handed out in order, so every slab from this one on is zero.
+    uint16_t pristine;
+
+    // Whether the short slab has not been handed out since this superslab
+    // was fresh.
+    bool short_pristine;
+
     ModArray<SLAB_COUNT, Metaslab> meta;
 
     // Used size_t as results in better code in MSVC
@@ -91,6 +100,13 @@ namespace snmalloc
           {
             new (&(meta[i])) Metaslab();
           }
+          pristine = SLAB_COUNT;
+          short_pristine = false;
+        }
+        else
+        {
+          pristine = 1;
+          short_pristine = true;
         }
 
         // If this wasn't previously a Superslab, we need to set up the
@@ -156,10 +172,18 @@ namespace snmalloc
       return meta[slab_to_index(slab)];
     }
 
-    Slab* alloc_short_slab(sizeclass_t sizeclass)
+    /**
+     * Allocate the short slab for `sizeclass`, or a standard slab if the
+     * short slab is in use.  Sets `zeroed` if the slab's memory is known to
+     * be zero.
+     */
+    Slab* alloc_short_slab(sizeclass_t sizeclass, bool& zeroed)
     {
       if ((used & 1) == 1)
-        return alloc_slab(sizeclass);
+        return alloc_slab(sizeclass, zeroed);
+
+      zeroed = short_pristine;
+      short_pristine = false;
 
       meta[0].head = nullptr;
       // Set up meta data as if the entire slab has been turned into a free
@@ -178,12 +202,20 @@ namespace snmalloc
       return reinterpret_cast<Slab*>(this);
     }
 
-    Slab* alloc_slab(sizeclass_t sizeclass)
+    /**
+     * Allocate a standard slab for `sizeclass`.  Sets `zeroed` if the slab's
+     * memory is known to be zero.
+     */
+    Slab* alloc_slab(sizeclass_t sizeclass, bool& zeroed)
     {
       uint8_t h = head;
       Slab* slab = pointer_offset(
         reinterpret_cast<Slab*>(this), (static_cast<size_t>(h) << SLAB_BITS));
 
+      zeroed = h == pristine;
+      if (zeroed)
+        pristine++;
+
       uint8_t n = meta[h].next;
 
       meta[h].head = nullptr;
@@ -9,4 +9,26 @@ void get_malloc_info_v1(malloc_info_v1* stats)
   auto next_memory_usage = default_memory_provider().memory_usage();
   stats->current_memory_usage = next_memory_usage.first;
   stats->peak_memory_usage = next_memory_usage.second;
-}
\ No newline at end of file
+}
+void get_malloc_info_v2(malloc_info_v2* stats)
+{
+  auto& provider = default_memory_provider();
+  size_t available = provider.available_large_chunks_in_bytes;
+  size_t decommitted = provider.decommitted_bytes;
+  size_t medium_decommitted = provider.medium_decommitted_bytes;
+  size_t chunks_decommitted =
+    decommitted - bits::min(decommitted, medium_decommitted);
+  auto remote = current_alloc_pool()->remote_bytes();
+
+  stats->small_bytes = provider.chunk_bytes[SmallChunk];
+  stats->medium_bytes = provider.chunk_bytes[MediumChunk];
+  stats->large_bytes = provider.chunk_bytes[LargeChunk];
+  stats->cached_bytes =
+    available > chunks_decommitted ? available - chunks_decommitted : 0;
+  stats->decommitted_bytes = decommitted;
+  stats->unused_reserved_bytes = provider.unused_reserved_bytes();
+  stats->metadata_bytes = provider.metadata_bytes;
+  stats->remote_cache_bytes = remote.first;
+  stats->message_queue_bytes = remote.second;
+  stats->peak_memory_usage = provider.memory_usage().second;
+}
@@ -32,3 +32,68 @@ struct malloc_info_v1
  * from snmalloc.
  */
 void get_malloc_info_v1(malloc_info_v1* stats);
+
+/**
+ * Structure for returning a breakdown of the memory used by snmalloc.
+ *
+ * Every field is maintained incrementally, or summed over the allocators,
+ * so collecting these does not walk the heap.  Chunks are counted in whole
+ * while they are handed out, so the small and medium figures include the
+ * free space within slabs.
+ */
+struct malloc_info_v2
+{
+  /**
+   * Bytes of chunks used for small, medium and large allocations.
+   */
+  size_t small_bytes;
+  size_t medium_bytes;
+  size_t large_bytes;
+
+  /**
+   * Bytes of free chunks cached for reuse that are still committed.
+   */
+  size_t cached_bytes;
+
+  /**
+   * Bytes that have been decommitted, but whose address space is still
+   * reserved: free chunks cached for reuse, and free medium objects in
+   * medium chunks that are in use.
+   */
+  size_t decommitted_bytes;
+
+  /**
+   * Bytes of address space reserved from the OS but never used.
+   */
+  size_t unused_reserved_bytes;
+
+  /**
+   * Bytes used for the allocator's own data structures, such as the
+   * allocators themselves and the nodes of a two-level pagemap.  A flat
+   * pagemap is static data and is not included.
+   */
+  size_t metadata_bytes;
+
+  /**
+   * Bytes of freed objects that are cached by the freeing thread before
+   * being sent to their owning allocator.
+   */
+  size_t remote_cache_bytes;
+
+  /**
+   * Bytes of freed objects waiting in their owning allocator's message
+   * queue.
+   */
+  size_t message_queue_bytes;
+
+  /**
+   * High-water mark of the memory used by snmalloc, as for malloc_info_v1.
+   */
+  size_t peak_memory_usage;
+};
+
+/**
+ * Populates a malloc_info_v2 structure for the latest values
+ * from snmalloc.
+ */
+void get_malloc_info_v2(malloc_info_v2* stats);
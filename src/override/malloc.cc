@@ -1,3 +1,4 @@
+#include "../mem/objectcopy.h"
 #include "../mem/slowalloc.h"
 #include "../snmalloc.h"
 
@@ -22,6 +23,304 @@ using namespace snmalloc;
 #  define MALLOC_USABLE_SIZE_QUALIFIER
 #endif
 
+namespace
+{
+  /**
+   * Counter returned by the `epoch` control.  snmalloc's statistics are
+   * always current, so this only exists for tools that expect to refresh
+   * them by writing to it.
+   */
+  std::atomic<uint64_t> mallctl_epoch{1};
+
+  /**
+   * Copy `value` out through the `oldp`/`oldlenp` arguments of `mallctl`.
+   * Nothing is copied if `oldp` is null.
+   */
+  template<typename T>
+  int mallctl_out(T value, void* oldp, size_t* oldlenp)
+  {
+    if (oldp == nullptr)
+      return 0;
+
+    if ((oldlenp == nullptr) || (*oldlenp != sizeof(T)))
+      return EINVAL;
+
+    memcpy(oldp, &value, sizeof(T));
+    return 0;
+  }
+
+  /**
+   * Read a new value from the `newp`/`newlen` arguments of `mallctl`.
+   * Returns false, leaving `value` unchanged, if none was supplied.
+   */
+  template<typename T>
+  bool mallctl_in(T& value, void* newp, size_t newlen, int& result)
+  {
+    if (newp == nullptr)
+      return false;
+
+    if (newlen != sizeof(T))
+    {
+      result = EINVAL;
+      return false;
+    }
+
+    memcpy(&value, newp, sizeof(T));
+    return true;
+  }
+
+  /**
+   * A read-only control.
+   */
+  template<typename T>
+  int mallctl_read(T value, void* oldp, size_t* oldlenp, void* newp)
+  {
+    if (newp != nullptr)
+      return EPERM;
+
+    return mallctl_out(value, oldp, oldlenp);
+  }
+
+  /**
+   * A control that performs an action and neither reads nor writes data.
+   */
+  int mallctl_action(void* oldp, void* newp)
+  {
+    if ((oldp != nullptr) || (newp != nullptr))
+      return EINVAL;
+
+    return 0;
+  }
+
+  /**
+   * If `name` starts with `prefix` followed by a decimal index and a '.',
+   * store the index, advance `name` past the '.' and return true.
+   */
+  bool mallctl_index(const char*& name, const char* prefix, size_t& index)
+  {
+    size_t len = strlen(prefix);
+    if (strncmp(name, prefix, len) != 0)
+      return false;
+
+    const char* p = name + len;
+    if ((*p < '0') || (*p > '9'))
+      return false;
+
+    // Reject indices too long to be meaningful rather than overflowing.
+    size_t digits = 0;
+    index = 0;
+    while ((*p >= '0') && (*p <= '9'))
+    {
+      if (++digits > 9)
+        return false;
+      index = (index * 10) + static_cast<size_t>(*p - '0');
+      p++;
+    }
+
+    if (*p != '.')
+      return false;
+
+    name = p + 1;
+    return true;
+  }
+
+  /**
+   * Return cached memory to the system: flush the calling thread's remote
+   * deallocations, drain every allocator that is not owned by a thread, and
+   * decommit the chunks that are now cached by the memory provider.
+   */
+  void mallctl_purge()
+  {
+    ThreadAlloc::get_noncachable()->flush_remote();
+    current_alloc_pool()->drain_overloaded(0);
+    default_memory_provider().decommit_cached();
+  }
+
+  int mallctl_sizeclass(
+    const char* name, size_t sc, void* oldp, size_t* oldlenp, void* newp)
+  {
+    if (sc >= NUM_SIZECLASSES)
+      return ENOENT;
+
+    if (strcmp(name, "size") == 0)
+      return mallctl_read(sizeclass_to_size(sc), oldp, oldlenp, newp);
+
+    Stats stats;
+    current_alloc_pool()->aggregate_stats(stats);
+    auto& counters = stats.counters[sc];
+
+    if (strcmp(name, "slabs") == 0)
+      return mallctl_read(counters.current_slabs(), oldp, oldlenp, newp);
+    if (strcmp(name, "refills") == 0)
+      return mallctl_read(size_t(counters.refills), oldp, oldlenp, newp);
+    if (strcmp(name, "refilled_objects") == 0)
+      return mallctl_read(
+        size_t(counters.refilled_objects), oldp, oldlenp, newp);
+    if (strcmp(name, "remote_received") == 0)
+      return mallctl_read(
+        size_t(counters.remote_received), oldp, oldlenp, newp);
+
+    return ENOENT;
+  }
+
+  int mallctl_large_class(
+    const char* name, size_t lc, void* oldp, size_t* oldlenp, void* newp)
+  {
+    if (lc >= NUM_LARGE_CLASSES)
+      return ENOENT;
+
+    if (strcmp(name, "size") == 0)
+    {
+      size_t size = large_sizeclass_to_size(static_cast<uint8_t>(lc));
+      return mallctl_read(size, oldp, oldlenp, newp);
+    }
+    if (strcmp(name, "cached") == 0)
+    {
+      size_t cached = default_memory_provider().large_stack_count[lc];
+      return mallctl_read(cached, oldp, oldlenp, newp);
+    }
+
+    return ENOENT;
+  }
+
+  /**
+   * Read bucket `<i>` of a latency histogram, named `bucket.<i>.<path>`, from
+   * the calling thread's allocator if `thread` is true and aggregated across
+   * all allocators otherwise.  The memory provider paths are process-wide.
+   */
+  int mallctl_latency(
+    const char* name, bool thread, void* oldp, size_t* oldlenp, void* newp)
+  {
+    if (strcmp(name, "buckets") == 0)
+      return mallctl_read(
+        size_t(TickHistogram<>::BUCKETS), oldp, oldlenp, newp);
+
+    size_t index;
+    if (
+      !mallctl_index(name, "bucket.", index) ||
+      (index >= TickHistogram<>::BUCKETS))
+      return ENOENT;
+
+    auto& provider = default_memory_provider();
+    if (!thread && (strcmp(name, "reserve") == 0))
+      return mallctl_read(
+        size_t(provider.reserve_latency.buckets[index]), oldp, oldlenp, newp);
+    if (!thread && (strcmp(name, "notify_using") == 0))
+      return mallctl_read(
+        size_t(provider.notify_using_latency.buckets[index]),
+        oldp,
+        oldlenp,
+        newp);
+
+    Stats stats;
+    if (thread)
+      stats.add(ThreadAlloc::get_noncachable()->stats());
+    else
+      current_alloc_pool()->aggregate_stats(stats);
+
+    if (strcmp(name, "alloc_slab") == 0)
+      return mallctl_read(
+        size_t(stats.alloc_slab_latency.buckets[index]), oldp, oldlenp, newp);
+    if (strcmp(name, "large_alloc") == 0)
+      return mallctl_read(
+        size_t(stats.large_alloc_latency.buckets[index]), oldp, oldlenp, newp);
+    if (strcmp(name, "message_queue") == 0)
+      return mallctl_read(
+        size_t(stats.message_queue_latency.buckets[index]),
+        oldp,
+        oldlenp,
+        newp);
+
+    return ENOENT;
+  }
+
+  int mallctl_opt(
+    const char* name, void* oldp, size_t* oldlenp, void* newp, size_t newlen)
+  {
+    int result = 0;
+
+    if (strcmp(name, "remote_cache_budget") == 0)
+    {
+      size_t budget = static_cast<size_t>(remote_cache_budget.load());
+      result = mallctl_out(budget, oldp, oldlenp);
+      if ((result == 0) && mallctl_in(budget, newp, newlen, result))
+      {
+        if (budget > static_cast<size_t>(INT64_MAX))
+          return EINVAL;
+        remote_cache_budget = static_cast<int64_t>(budget);
+      }
+      return result;
+    }
+
+    if (strcmp(name, "decommit_policy") == 0)
+    {
+      auto& policy = default_memory_provider().decommit_policy;
+      unsigned value = static_cast<unsigned>(policy.load());
+      result = mallctl_out(value, oldp, oldlenp);
+      if ((result == 0) && mallctl_in(value, newp, newlen, result))
+      {
+        if (value > DecommitSuperLazy)
+          return EINVAL;
+        // Lazy decommit relies on the platform reporting memory pressure.
+        if (
+          (value == DecommitSuperLazy) &&
+          !pal_supports<LowMemoryNotification, GlobalVirtual::Pal>)
+          return EINVAL;
+        policy = static_cast<DecommitStrategy>(value);
+      }
+      return result;
+    }
+
+    return ENOENT;
+  }
+
+  int mallctl_prof(
+    const char* name, void* oldp, size_t* oldlenp, void* newp, size_t newlen)
+  {
+    if constexpr (!HEAP_PROFILING)
+    {
+      UNUSED(name);
+      UNUSED(oldp);
+      UNUSED(oldlenp);
+      UNUSED(newp);
+      UNUSED(newlen);
+      return ENOENT;
+    }
+
+    int result = 0;
+
+    if (strcmp(name, "prof.dump") == 0)
+    {
+      const char* filename = nullptr;
+      if (oldp != nullptr)
+        return EINVAL;
+      if (!mallctl_in(filename, newp, newlen, result) || (filename == nullptr))
+        return EINVAL;
+
+      FILE* out = fopen(filename, "w");
+      if (out == nullptr)
+        return EFAULT;
+      HeapProfile::dump(out);
+      fclose(out);
+      return 0;
+    }
+
+    if (strcmp(name, "snmalloc.prof.interval") == 0)
+    {
+      size_t interval = HeapProfile::interval();
+      result = mallctl_out(interval, oldp, oldlenp);
+      if ((result == 0) && mallctl_in(interval, newp, newlen, result))
+        HeapProfile::set_interval(interval);
+      return result;
+    }
+
+    if (strcmp(name, "snmalloc.prof.dropped") == 0)
+      return mallctl_read(HeapProfile::dropped(), oldp, oldlenp, newp);
+
+    return ENOENT;
+  }
+} // namespace
+
 extern "C"
 {
   SNMALLOC_EXPORT void* SNMALLOC_NAME_MANGLE(__malloc_end_pointer)(void* ptr)
@@ -98,7 +397,7 @@ extern "C"
     {
       SNMALLOC_ASSERT(p == Alloc::external_pointer<Start>(p));
       sz = bits::min(size, sz);
-      memcpy(p, ptr, sz);
+      copy_object(p, ptr, sz);
       SNMALLOC_NAME_MANGLE(free)(ptr);
     }
     return p;
@@ -134,8 +433,7 @@ extern "C"
       return nullptr;
     }
 
-    return SNMALLOC_NAME_MANGLE(malloc)(
-      size ? aligned_size(alignment, size) : alignment);
+    return ThreadAlloc::get_noncachable()->alloc_aligned(alignment, size);
   }
 
   SNMALLOC_EXPORT void*
@@ -191,12 +489,218 @@ extern "C"
   SNMALLOC_EXPORT void SNMALLOC_NAME_MANGLE(_malloc_postfork)(void) {}
   SNMALLOC_EXPORT void SNMALLOC_NAME_MANGLE(_malloc_first_thread)(void) {}
 
-  SNMALLOC_EXPORT int
-    SNMALLOC_NAME_MANGLE(mallctl)(const char*, void*, size_t*, void*, size_t)
+  /**
+   * jemalloc-compatible control interface.  Supports the jemalloc names that
+   * common tooling uses (`epoch`, `stats.*`, `arena.<i>.purge`,
+   * `thread.tcache.flush`) and the snmalloc specific names.  Of the jemalloc
+   * statistics, `stats.active` is the bytes of chunks handed out to
+   * allocators, `stats.mapped` the address space used, and `stats.resident`
+   * that less the cached chunks that have been decommitted.  The bytes of
+   * live allocations are not tracked, so `stats.allocated` is not supported.
+   *
+   *  - `snmalloc.stats.{current,peak}_memory_usage`,
+   *    `snmalloc.stats.available_large_chunks`: `size_t` bytes.
+   *  - `snmalloc.sizeclasses`: the number of sizeclasses.
+   *  - `snmalloc.sizeclass.<i>.{size,slabs,refills,refilled_objects,
+   *    remote_received}`: `size_t` per-sizeclass slow path counters.
+   *  - `snmalloc.large_classes`: the number of large classes.
+   *  - `snmalloc.large_class.<i>.{size,cached}`: the chunk size and the
+   *    number of chunks cached in the memory provider.
+   *  - `snmalloc.cleanup_unused`: process the message queues of allocators
+   *    that are not owned by a thread.
+   *  - `snmalloc.decommit`: as `arena.<i>.purge`, return cached memory to
+   *    the system.
+   *  - `snmalloc.latency.buckets`: the number of buckets in a latency
+   *    histogram.
+   *  - `snmalloc.latency.bucket.<i>.<path>`: `size_t`, the number of slow
+   *    path calls that took [2^(i-1), 2^i) `Aal::tick()`s, for `<path>` one
+   *    of `alloc_slab`, `large_alloc`, `message_queue`, `reserve` and
+   *    `notify_using`.  `snmalloc.thread.latency.bucket.<i>.<path>` reads
+   *    the calling thread's allocator only, for the first three paths.
+   *  - `snmalloc.opt.remote_cache_budget`: read/write `size_t`.
+   *  - `snmalloc.opt.decommit_policy`: read/write `unsigned`, a
+   *    `DecommitStrategy`.
+   *
+   * With `HEAP_PROFILING`, also:
+   *
+   *  - `snmalloc.prof.interval`: read/write `size_t`, the mean number of
+   *    bytes between heap profile samples, zero to disable sampling.
+   *  - `snmalloc.prof.dropped`: samples lost because the table was full.
+   *  - `prof.dump`: write `const char*`, dump the heap profile to the named
+   *    file in pprof's format.
+   *
+   * Returns `ENOENT` for unknown names, `EINVAL` for a size mismatch or an
+   * invalid new value, and `EPERM` for a write to a read-only name.
+   */
+  SNMALLOC_EXPORT int SNMALLOC_NAME_MANGLE(mallctl)(
+    const char* name, void* oldp, size_t* oldlenp, void* newp, size_t newlen)
   {
+    if (name == nullptr)
+      return ENOENT;
+
+    auto& provider = default_memory_provider();
+    const char* suffix = name;
+    size_t index;
+
+    if (strcmp(name, "epoch") == 0)
+    {
+      uint64_t epoch = mallctl_epoch;
+      int result = 0;
+      if (mallctl_in(epoch, newp, newlen, result))
+        epoch = ++mallctl_epoch;
+      if (result != 0)
+        return result;
+      return mallctl_out(epoch, oldp, oldlenp);
+    }
+
+    if (strcmp(name, "stats.active") == 0)
+    {
+      size_t active = 0;
+      for (auto& bytes : provider.chunk_bytes)
+        active += bytes;
+      return mallctl_read(active, oldp, oldlenp, newp);
+    }
+
+    if (strcmp(name, "stats.resident") == 0)
+    {
+      size_t resident =
+        provider.memory_usage().second - provider.decommitted_bytes;
+      return mallctl_read(resident, oldp, oldlenp, newp);
+    }
+
+    if (strcmp(name, "snmalloc.stats.current_memory_usage") == 0)
+      return mallctl_read(provider.memory_usage().first, oldp, oldlenp, newp);
+
+    if (
+      (strcmp(name, "stats.mapped") == 0) ||
+      (strcmp(name, "snmalloc.stats.peak_memory_usage") == 0))
+      return mallctl_read(provider.memory_usage().second, oldp, oldlenp, newp);
+
+    if (strcmp(name, "snmalloc.stats.available_large_chunks") == 0)
+    {
+      size_t available = provider.available_large_chunks_in_bytes;
+      return mallctl_read(available, oldp, oldlenp, newp);
+    }
+
+    if (strcmp(name, "thread.tcache.flush") == 0)
+    {
+      int result = mallctl_action(oldp, newp);
+      if (result == 0)
+        ThreadAlloc::get_noncachable()->flush_remote();
+      return result;
+    }
+
+    if (
+      (mallctl_index(suffix, "arena.", index) &&
+       (strcmp(suffix, "purge") == 0)) ||
+      (strcmp(name, "snmalloc.decommit") == 0))
+    {
+      int result = mallctl_action(oldp, newp);
+      if (result == 0)
+        mallctl_purge();
+      return result;
+    }
+
+    if (strcmp(name, "snmalloc.cleanup_unused") == 0)
+    {
+      int result = mallctl_action(oldp, newp);
+      if (result == 0)
+        current_alloc_pool()->cleanup_unused();
+      return result;
+    }
+
+    if (strcmp(name, "snmalloc.sizeclasses") == 0)
+      return mallctl_read(size_t(NUM_SIZECLASSES), oldp, oldlenp, newp);
+
+    suffix = name;
+    if (mallctl_index(suffix, "snmalloc.sizeclass.", index))
+      return mallctl_sizeclass(suffix, index, oldp, oldlenp, newp);
+
+    if (strcmp(name, "snmalloc.large_classes") == 0)
+      return mallctl_read(size_t(NUM_LARGE_CLASSES), oldp, oldlenp, newp);
+
+    suffix = name;
+    if (mallctl_index(suffix, "snmalloc.large_class.", index))
+      return mallctl_large_class(suffix, index, oldp, oldlenp, newp);
+
+    if (strncmp(name, "snmalloc.latency.", 17) == 0)
+      return mallctl_latency(name + 17, false, oldp, oldlenp, newp);
+
+    if (strncmp(name, "snmalloc.thread.latency.", 24) == 0)
+      return mallctl_latency(name + 24, true, oldp, oldlenp, newp);
+
+    if (strncmp(name, "snmalloc.opt.", 13) == 0)
+      return mallctl_opt(name + 13, oldp, oldlenp, newp, newlen);
+
+    if (
+      (strncmp(name, "prof.", 5) == 0) ||
+      (strncmp(name, "snmalloc.prof.", 14) == 0))
+      return mallctl_prof(name, oldp, oldlenp, newp, newlen);
+
     return ENOENT;
   }
 
+  /**
+   * Return the remote deallocations cached by the calling thread to their
+   * owning allocators.  Intended to be called by threads before they block,
+   * so that memory they have freed is not held until they next run.
+   */
+  SNMALLOC_EXPORT void SNMALLOC_NAME_MANGLE(snmalloc_flush)(void)
+  {
+    ThreadAlloc::get_noncachable()->flush_remote();
+  }
+
+  /**
+   * Create an arena: an allocator owned by the caller rather than by a
+   * thread.  Objects allocated from an arena may be freed individually, with
+   * `snmalloc_arena_free` or `free`, or all at once by
+   * `snmalloc_arena_destroy`, subject to the rules given there for objects
+   * freed by other threads.  An arena must only be used by one thread at a
+   * time.  Arenas are taken from their own pool, never from the allocators
+   * released by exited threads, so they hold no memory but their own.
+   */
+  SNMALLOC_EXPORT void* SNMALLOC_NAME_MANGLE(snmalloc_arena_create)(void)
+  {
+    Alloc* a = current_arena_pool()->acquire();
+    a->track_large_allocations();
+    return a;
+  }
+
+  SNMALLOC_EXPORT void*
+    SNMALLOC_NAME_MANGLE(snmalloc_arena_alloc)(void* arena, size_t size)
+  {
+    return static_cast<Alloc*>(arena)->alloc(size);
+  }
+
+  SNMALLOC_EXPORT void
+    SNMALLOC_NAME_MANGLE(snmalloc_arena_free)(void* arena, void* ptr)
+  {
+    static_cast<Alloc*>(arena)->dealloc(ptr);
+  }
+
+  /**
+   * Free every object allocated from `arena` and return the arena's memory,
+   * in time proportional to the number of chunks it holds.  None of the
+   * arena's objects may be freed after, or concurrently with, this call.
+   *
+   * Objects freed with `free` are held in the freeing thread's remote cache
+   * until it is flushed, and must reach the arena before it is destroyed.
+   * This call flushes the calling thread's cache; any other thread that has
+   * freed objects of the arena must call `snmalloc_flush` after its last
+   * such free, and before this call.
+   */
+  SNMALLOC_EXPORT void SNMALLOC_NAME_MANGLE(snmalloc_arena_destroy)(void* arena)
+  {
+    if (arena == nullptr)
+      return;
+
+    ThreadAlloc::get_noncachable()->flush_remote();
+
+    auto* a = static_cast<Alloc*>(arena);
+    a->release_all();
+    current_arena_pool()->release(a);
+  }
+
 #ifdef SNMALLOC_EXPOSE_PAGEMAP
   /**
    * Export the pagemap.  The return value is a pointer to the pagemap
@@ -6,6 +6,7 @@
 
 #  include <string.h>
 #  include <sys/mman.h>
+#  include <unistd.h>
 
 extern "C" int puts(const char* str);
 
@@ -28,6 +29,30 @@ namespace snmalloc
     static constexpr size_t page_size =
       Aal::aal_name == PowerPC ? 0x10000 : 0x1000;
 
+    /**
+     * Ranges at least this large are zeroed with streaming stores, which do
+     * not pollute the cache.  Smaller ranges are likely to be in the cache
+     * already, and are cleared with `memset`.  Chosen with `perf-zero`.
+     */
+    static constexpr size_t zero_streaming_threshold = 16 * page_size;
+
+    /**
+     * Ranges that callers guarantee to be page aligned, larger than this, are
+     * zeroed by discarding their pages.  These include the chunks zeroed by
+     * `notify_using`, which are often fresh or decommitted and may never be
+     * used in full, so writing them would commit memory that is not needed.
+     */
+    static constexpr size_t zero_discard_threshold = 16 * page_size;
+
+    /**
+     * Other ranges of whole pages at least this large, which are usually
+     * dirty objects being cleared, are also zeroed by discarding their
+     * pages.  Faulting the pages back in costs more than zeroing them
+     * directly, so this is only worth it for ranges large enough that they
+     * may not be used in full, and whose memory is then returned to the OS.
+     */
+    static constexpr size_t zero_madvise_threshold = 512 * page_size;
+
     /**
      * OS specific function for zeroing memory.
      *
@@ -43,19 +68,130 @@ namespace snmalloc
       // MADV_DONTNEED. switch back to memset only for QEMU.
 #  ifndef SNMALLOC_QEMU_WORKAROUND
       if (
-        (page_aligned || is_aligned_block<page_size>(p, size)) &&
-        (size > 16 * page_size))
+        (page_aligned && (size > zero_discard_threshold)) ||
+        (is_aligned_block<page_size>(p, size) &&
+         (size >= zero_madvise_threshold)))
       {
-        // Only use this on large allocations as memset faster, and doesn't
-        // introduce IPI so faster for small allocations.
         SNMALLOC_ASSERT(is_aligned_block<page_size>(p, size));
         madvise(p, size, MADV_DONTNEED);
+        return;
       }
+#  endif
+
+      if (size >= zero_streaming_threshold)
+        Aal::zero_streaming(p, size);
       else
+        ::memset(p, 0, size);
+    }
+
+#  ifdef USE_LINUX_MADV_FREE
+    /**
+     * Notify platform that we will not be using these pages.
+     *
+     * `MADV_FREE` lets the kernel reclaim the pages lazily, when there is
+     * memory pressure, and until then a write cancels it.  Older kernels
+     * only have `MADV_DONTNEED`, which discards the pages immediately.
+     *
+     * This is opt in: with the default eager decommit strategy every large
+     * chunk is decommitted as it is freed, and reusing the pages afterwards
+     * costs far more than leaving them committed, as the POSIX PAL does.
+     */
+    static void notify_not_using(void* p, size_t size) noexcept
+    {
+      SNMALLOC_ASSERT(is_aligned_block<page_size>(p, size));
+#    ifdef MADV_FREE
+      madvise(p, size, MADV_FREE);
+#    else
+      madvise(p, size, MADV_DONTNEED);
+#    endif
+      PALPOSIX::notify_not_using(p, size);
+    }
 #  endif
+
+    /**
+     * Create a shared memory object of `size` bytes and map it read-write at
+     * an address aligned to `align`.  Returns the mapping and a file
+     * descriptor that other processes can pass to `map_shared_at` to map the
+     * same memory, or `{nullptr, -1}` on failure.  The descriptor is closed
+     * on `exec`.
+     */
+    static std::pair<void*, int> map_shared(size_t size, size_t align) noexcept
+    {
+      int fd = memfd_create("snmalloc", MFD_CLOEXEC);
+      if (fd < 0)
+        return {nullptr, -1};
+
+      if (ftruncate(fd, static_cast<off_t>(size)) != 0)
       {
-        ::memset(p, 0, size);
+        close(fd);
+        return {nullptr, -1};
+      }
+
+      // Reserve enough address space to align the mapping, then trim it.
+      void* reservation = mmap(
+        nullptr,
+        size + align,
+        PROT_NONE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+        -1,
+        0);
+      if (reservation == MAP_FAILED)
+      {
+        close(fd);
+        return {nullptr, -1};
+      }
+
+      void* p = pointer_align_up(reservation, align);
+      void* end = pointer_offset(p, size);
+      void* reservation_end = pointer_offset(reservation, size + align);
+      if (p != reservation)
+        munmap(reservation, pointer_diff(reservation, p));
+      if (end != reservation_end)
+        munmap(end, pointer_diff(end, reservation_end));
+
+      if (
+        mmap(p, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) ==
+        MAP_FAILED)
+      {
+        munmap(p, size);
+        close(fd);
+        return {nullptr, -1};
+      }
+
+      return {p, fd};
+    }
+
+    /**
+     * Map `size` bytes of the shared memory object `fd` read-write at
+     * `address`, without replacing any existing mapping, or anywhere if
+     * `address` is null.  Returns nullptr on failure.
+     */
+    static void* map_shared_at(int fd, void* address, size_t size) noexcept
+    {
+      int flags = MAP_SHARED;
+#  ifdef MAP_FIXED_NOREPLACE
+      if (address != nullptr)
+        flags |= MAP_FIXED_NOREPLACE;
+#  endif
+      void* p = mmap(address, size, PROT_READ | PROT_WRITE, flags, fd, 0);
+      if (p == MAP_FAILED)
+        return nullptr;
+
+      // Without MAP_FIXED_NOREPLACE, the address is only a hint.
+      if ((address != nullptr) && (p != address))
+      {
+        munmap(p, size);
+        return nullptr;
       }
+      return p;
+    }
+
+    /**
+     * Remove a mapping made by `map_shared` or `map_shared_at`.
+     */
+    static void unmap_shared(void* p, size_t size) noexcept
+    {
+      munmap(p, size);
     }
   };
 } // namespace snmalloc
@@ -113,6 +113,23 @@ namespace snmalloc
 #endif
     }
 
+    /**
+     * Store up to `max` return addresses from the current call stack in
+     * `frames`, and return how many were stored.  Returns zero if the
+     * platform has no backtrace support.
+     */
+    static size_t capture_stack(void** frames, size_t max)
+    {
+#ifdef BACKTRACE_HEADER
+      auto depth = backtrace(frames, static_cast<int>(max));
+      return depth < 0 ? 0 : static_cast<size_t>(depth);
+#else
+      UNUSED(frames);
+      UNUSED(max);
+      return 0;
+#endif
+    }
+
     /**
      * Report a fatal error an exit.
      */
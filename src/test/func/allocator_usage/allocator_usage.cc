@@ -0,0 +1,113 @@
+/**
+ * Checks the memory charged to individual allocators, and finding the
+ * allocators used by a thread through their tags.
+ */
+#ifndef USE_LARGE_OWNER_TRACKING
+#  define USE_LARGE_OWNER_TRACKING
+#endif
+
+#include <snmalloc.h>
+#include <test/setup.h>
+#include <thread>
+#include <vector>
+
+using namespace snmalloc;
+
+static constexpr uintptr_t TENANT = 42;
+
+static size_t tagged_bytes(uintptr_t tag)
+{
+  size_t total = 0;
+  current_alloc_pool()->for_each([&](Alloc* alloc) {
+    if (alloc->get_tag() == tag)
+      total += alloc->memory_usage().total();
+  });
+  return total;
+}
+
+int main()
+{
+  setup();
+
+  auto* pool = current_alloc_pool();
+  Alloc* a = pool->acquire();
+  Alloc* b = pool->acquire();
+
+  // Each allocator starts with a superslab, which holds its message queue
+  // stub.
+  AllocatorMemoryUsage initial = a->memory_usage();
+  size_t b_initial = b->memory_usage().total();
+  if (initial.small_bytes != SUPERSLAB_SIZE)
+    abort();
+
+  void* small = a->alloc(64);
+  void* medium = a->alloc(SUPERSLAB_SIZE / 8);
+  size_t large_size = 2 * SUPERSLAB_SIZE;
+  void* large = a->alloc(large_size);
+
+  AllocatorMemoryUsage usage = a->memory_usage();
+  if (usage.small_bytes != initial.small_bytes)
+    abort();
+  if (usage.medium_bytes < initial.medium_bytes + SUPERSLAB_SIZE)
+    abort();
+  if (usage.large_bytes != initial.large_bytes + large_size)
+    abort();
+  if (b->memory_usage().total() != b_initial)
+    abort();
+
+  // Large allocations are credited back to the allocator that made them,
+  // whichever allocator frees them.
+  b->dealloc(large);
+  if (a->memory_usage().large_bytes != initial.large_bytes)
+    abort();
+  if (b->memory_usage().large_bytes != 0)
+    abort();
+
+  a->dealloc(medium);
+  a->dealloc(small);
+  if (a->memory_usage().medium_bytes != initial.medium_bytes)
+    abort();
+
+  // More live large allocations than fit in one owner table are all
+  // charged.
+  static constexpr size_t LARGE_COUNT = 5000;
+  std::vector<void*> larges;
+  for (size_t i = 0; i < LARGE_COUNT; i++)
+    larges.push_back(a->alloc(large_size));
+  size_t charged = LARGE_COUNT * large_size;
+  if (a->memory_usage().large_bytes != initial.large_bytes + charged)
+    abort();
+  for (auto p : larges)
+    b->dealloc(p);
+  if (a->memory_usage().large_bytes != initial.large_bytes)
+    abort();
+
+  pool->release(a);
+  pool->release(b);
+
+  // A thread can tag its allocator so that it can be found and measured
+  // from another thread.
+  std::atomic<bool> allocated{false};
+  std::atomic<bool> done{false};
+  std::thread tenant([&]() {
+    ThreadAlloc::get()->set_tag(TENANT);
+    void* p = ThreadAlloc::get()->alloc(large_size);
+    allocated = true;
+    while (!done)
+      std::this_thread::yield();
+    ThreadAlloc::get()->dealloc(p);
+  });
+
+  while (!allocated)
+    std::this_thread::yield();
+  if (tagged_bytes(TENANT) < large_size)
+    abort();
+  done = true;
+  tenant.join();
+
+  // The tag is cleared when the thread's allocator is returned to the pool.
+  if (tagged_bytes(TENANT) != 0)
+    abort();
+
+  return 0;
+}
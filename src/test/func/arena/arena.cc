@@ -0,0 +1,148 @@
+/**
+ * Checks that destroying an arena frees all of its objects at once, and
+ * only its objects, and that the arena's allocator can be used again
+ * afterwards.
+ */
+#include <test/setup.h>
+#include <thread>
+
+#define SNMALLOC_NAME_MANGLE(a) our_##a
+#include "../../../override/malloc.cc"
+
+using namespace snmalloc;
+
+// Enough small objects, averaging about 512 bytes, to fill several
+// superslabs.
+static constexpr size_t SMALL_COUNT = 4 * SUPERSLAB_SIZE / 512;
+static constexpr size_t MEDIUM_COUNT = 16;
+
+/**
+ * Objects allocated by a thread that then exits, leaving them live.
+ */
+static constexpr size_t THREAD_COUNT = 3;
+static void* thread_objects[THREAD_COUNT];
+static constexpr size_t thread_sizes[THREAD_COUNT] = {
+  64, SUPERSLAB_SIZE / 4, 2 * SUPERSLAB_SIZE};
+
+static void check_thread_objects()
+{
+  for (size_t i = 0; i < THREAD_COUNT; i++)
+  {
+    auto* bytes = static_cast<uint8_t*>(thread_objects[i]);
+    for (size_t j = 0; j < thread_sizes[i]; j++)
+    {
+      if (bytes[j] != 0xa5)
+        abort();
+    }
+  }
+}
+
+int main()
+{
+  setup();
+
+  // The exited thread's allocator goes back to the pool still owning these
+  // objects, and must not be handed out as an arena.
+  std::thread t([]() {
+    for (size_t i = 0; i < THREAD_COUNT; i++)
+    {
+      thread_objects[i] = our_malloc(thread_sizes[i]);
+      memset(thread_objects[i], 0xa5, thread_sizes[i]);
+    }
+  });
+  t.join();
+
+  auto& provider = default_memory_provider();
+  size_t large_before = provider.chunk_bytes[LargeChunk];
+  size_t medium_before = provider.chunk_bytes[MediumChunk];
+
+  void* arena = our_snmalloc_arena_create();
+  Alloc* a = static_cast<Alloc*>(arena);
+
+  static void* small[SMALL_COUNT];
+  for (size_t i = 0; i < SMALL_COUNT; i++)
+    small[i] = our_snmalloc_arena_alloc(arena, 16 + (i % 64) * 16);
+
+  void* medium[MEDIUM_COUNT];
+  for (size_t i = 0; i < MEDIUM_COUNT; i++)
+    medium[i] = our_snmalloc_arena_alloc(arena, SUPERSLAB_SIZE / 4);
+
+  size_t large_size = 2 * SUPERSLAB_SIZE;
+  void* large = our_snmalloc_arena_alloc(arena, large_size);
+  void* freed_large = our_snmalloc_arena_alloc(arena, large_size);
+
+  // Free some objects individually, both through the arena and through
+  // another allocator, so that some are waiting in the arena's queue.
+  our_snmalloc_arena_free(arena, small[0]);
+  our_snmalloc_arena_free(arena, freed_large);
+  Alloc* other = current_alloc_pool()->acquire();
+  for (size_t i = 1; i < 100; i++)
+    other->dealloc(small[i]);
+  other->flush_remote();
+
+  // Objects freed by the destroying thread may still be in its remote cache,
+  // which destroying the arena flushes.
+  our_free(small[100]);
+  our_free(small[101]);
+  if (ThreadAlloc::get_noncachable()->remote_cached_bytes() == 0)
+    abort();
+
+  AllocatorMemoryUsage usage = a->memory_usage();
+  if (usage.small_bytes < 2 * SUPERSLAB_SIZE)
+    abort();
+  if (usage.medium_bytes < MEDIUM_COUNT * SUPERSLAB_SIZE / 4)
+    abort();
+  if (usage.large_bytes != large_size)
+    abort();
+
+  our_snmalloc_arena_destroy(arena);
+  if (ThreadAlloc::get_noncachable()->remote_cached_bytes() != 0)
+    abort();
+
+  // Only the superslab holding the message queue stub remains.
+  usage = a->memory_usage();
+  if (usage.small_bytes != SUPERSLAB_SIZE)
+    abort();
+  if ((usage.medium_bytes != 0) || (usage.large_bytes != 0))
+    abort();
+  if (provider.chunk_bytes[LargeChunk] != large_before)
+    abort();
+  if (provider.chunk_bytes[MediumChunk] != medium_before)
+    abort();
+
+  // The exited thread's objects are still live and intact.
+  check_thread_objects();
+  using ChunkMap = SNMALLOC_DEFAULT_CHUNKMAP;
+  for (auto object : thread_objects)
+  {
+    if (ChunkMap::get(address_cast(object)) == CMNotOurs)
+      abort();
+  }
+
+  // The pagemap no longer refers to the released chunks.
+  if (ChunkMap::get(address_cast(small[SMALL_COUNT - 1])) != CMNotOurs)
+    abort();
+  if (ChunkMap::get(address_cast(medium[0])) != CMNotOurs)
+    abort();
+  if (ChunkMap::get(address_cast(large)) != CMNotOurs)
+    abort();
+
+  // The allocator is back in the arena pool and is reused for the next
+  // arena.
+  arena = our_snmalloc_arena_create();
+  void* p = our_snmalloc_arena_alloc(arena, 64);
+  our_snmalloc_arena_free(arena, p);
+  if (arena != a)
+    abort();
+  our_snmalloc_arena_destroy(arena);
+  our_snmalloc_arena_destroy(nullptr);
+
+  check_thread_objects();
+  for (auto object : thread_objects)
+    our_free(object);
+  ThreadAlloc::get_noncachable()->flush_remote();
+
+  current_alloc_pool()->release(other);
+  current_alloc_pool()->debug_check_empty();
+  return 0;
+}
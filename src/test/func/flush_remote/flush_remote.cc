@@ -0,0 +1,47 @@
+/**
+ * Checks that `flush_remote` sends cached remote deallocations to their
+ * owners without waiting for the remote cache budget to be used up.
+ */
+#include <snmalloc.h>
+#include <test/setup.h>
+
+using namespace snmalloc;
+
+int main()
+{
+  setup();
+
+  auto* pool = current_alloc_pool();
+  Alloc* owner = pool->acquire();
+  Alloc* other = pool->acquire();
+
+  void* p = owner->alloc(64);
+  void* q = owner->alloc(64);
+  size_t before = owner->remote_queued_bytes();
+
+  // The first remote deallocation takes the slow path and posts immediately,
+  // the second one stays in the cache.
+  other->dealloc(p);
+  other->dealloc(q);
+
+  if (owner->remote_queued_bytes() != before + 64)
+    abort();
+
+  other->flush_remote();
+
+  // Both deallocations are now queued at the owner.
+  if (owner->remote_queued_bytes() != before + 128)
+    abort();
+
+  // Flushing the placeholder allocator must be a no-op.
+  ThreadAlloc::get_noncachable()->flush_remote();
+
+  // The owner returns both objects when it processes its queue.
+  owner->flush_remote();
+
+  pool->release(owner);
+  pool->release(other);
+
+  pool->debug_check_empty();
+  return 0;
+}
@@ -0,0 +1,112 @@
+/**
+ * Checks the per-sizeclass slab occupancy reported for fragmentation
+ * analysis.
+ */
+#include <snmalloc.h>
+#include <test/setup.h>
+#include <vector>
+
+using namespace snmalloc;
+
+static constexpr size_t SMALL_SIZE = 48;
+static constexpr size_t SMALL_COUNT = 10000;
+static constexpr size_t MEDIUM_SIZE = 100000;
+static constexpr size_t MEDIUM_COUNT = 20;
+
+int main()
+{
+  setup();
+
+  auto* pool = current_alloc_pool();
+  Alloc* a = pool->acquire();
+
+  std::vector<void*> small;
+  std::vector<void*> medium;
+  for (size_t i = 0; i < SMALL_COUNT; i++)
+    small.push_back(a->alloc(SMALL_SIZE));
+  for (size_t i = 0; i < MEDIUM_COUNT; i++)
+    medium.push_back(a->alloc(MEDIUM_SIZE));
+
+  // Free every other small object, leaving every slab about half full.
+  for (size_t i = 0; i < SMALL_COUNT; i += 2)
+    a->dealloc(small[i]);
+
+  sizeclass_t small_sc = size_to_sizeclass(SMALL_SIZE);
+  sizeclass_t medium_sc = size_to_sizeclass(MEDIUM_SIZE);
+
+  {
+    FragmentationReport report;
+    a->report_fragmentation(report);
+
+    // Objects in the allocator's free lists are counted as live.
+    auto& s = report.sizeclasses[small_sc];
+    if ((s.slabs == 0) || (s.live_objects < SMALL_COUNT / 2))
+      abort();
+    if (s.live_objects > s.capacity)
+      abort();
+    if (report.superslabs == 0)
+      abort();
+
+    auto& m = report.sizeclasses[medium_sc];
+    if (m.live_objects != MEDIUM_COUNT)
+      abort();
+    if (report.mediumslabs != m.slabs)
+      abort();
+  }
+
+  // Once the allocator's caches are flushed, the counts are exact.
+  pool->release(a);
+  if (!pool->try_drain(a))
+    abort();
+
+  {
+    FragmentationReport report;
+    a->report_fragmentation(report);
+
+    auto& s = report.sizeclasses[small_sc];
+    if (s.live_objects != SMALL_COUNT / 2)
+      abort();
+
+    size_t slabs = 0;
+    for (size_t i = 0; i < SlabOccupancy::BUCKETS; i++)
+      slabs += s.occupancy[i];
+    if (slabs != s.slabs)
+      abort();
+
+    // Every slab has half of its objects in use, except perhaps the last,
+    // which was only partly allocated.
+    if (s.occupancy[1] + s.occupancy[2] + 1 < s.slabs)
+      abort();
+    if ((s.occupancy[3] != 0) || (s.occupancy[4] != 0))
+      abort();
+    if (report.free_bytes(small_sc) == 0)
+      abort();
+
+    // The pool wide report includes this allocator.
+    FragmentationReport all;
+    pool->report_fragmentation(all);
+    if (all.sizeclasses[small_sc].live_objects < s.live_objects)
+      abort();
+  }
+
+  // The pool may hand out a different allocator, which returns the objects
+  // to `a` remotely.
+  a = pool->acquire();
+  for (size_t i = 1; i < SMALL_COUNT; i += 2)
+    a->dealloc(small[i]);
+  for (void* p : medium)
+    a->dealloc(p);
+  pool->release(a);
+  pool->debug_check_empty();
+
+  // Slabs that are entirely free are returned to the memory provider, and so
+  // no longer reported.
+  FragmentationReport report;
+  pool->report_fragmentation(report);
+  if (report.sizeclasses[small_sc].slabs != 0)
+    abort();
+  if ((report.sizeclasses[medium_sc].slabs != 0) || (report.mediumslabs != 0))
+    abort();
+
+  return 0;
+}
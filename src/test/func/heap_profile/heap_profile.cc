@@ -0,0 +1,102 @@
+/**
+ * Checks that the sampling heap profiler records live objects, forgets them
+ * when they are freed, and dumps them in pprof's text format.
+ */
+#ifndef USE_HEAP_PROFILING
+#  define USE_HEAP_PROFILING
+#endif
+
+#include <snmalloc.h>
+#include <stdio.h>
+#include <string.h>
+#include <test/setup.h>
+#include <vector>
+
+using namespace snmalloc;
+
+static constexpr size_t INTERVAL = 4096;
+static constexpr size_t OBJECT_SIZE = 256;
+static constexpr size_t OBJECT_COUNT = 8192;
+
+/**
+ * Dump the profile and return the number of samples in it, checking the
+ * header on the way.
+ */
+static size_t dump_and_count()
+{
+  FILE* f = tmpfile();
+  if (f == nullptr)
+    abort();
+
+  HeapProfile::dump(f);
+  rewind(f);
+
+  char line[4096];
+  if (fgets(line, sizeof(line), f) == nullptr)
+    abort();
+  if (strncmp(line, "heap profile: ", 14) != 0)
+    abort();
+  if (strstr(line, "@ heap_v2/4096") == nullptr)
+    abort();
+
+  size_t samples = 0;
+  while (fgets(line, sizeof(line), f) != nullptr)
+  {
+    if (strncmp(line, "MAPPED_LIBRARIES:", 17) == 0)
+      break;
+    if (strncmp(line, "1: 256 [1: 256] @", 17) == 0)
+      samples++;
+  }
+
+  fclose(f);
+  return samples;
+}
+
+int main()
+{
+  setup();
+
+  if (HeapProfile::has_samples())
+    abort();
+
+  HeapProfile::set_interval(INTERVAL);
+
+  auto* a = ThreadAlloc::get();
+  std::vector<void*> objects;
+  objects.reserve(OBJECT_COUNT);
+
+  for (size_t i = 0; i < OBJECT_COUNT; i++)
+    objects.push_back(a->alloc(OBJECT_SIZE));
+
+  // 2 MiB allocated with a mean interval of 4 KiB should give about 512
+  // samples; allow generous slack for the randomness.
+  size_t samples = dump_and_count();
+  if ((samples < 256) || (samples > 1024))
+  {
+    printf("Unexpected number of samples: %zu\n", samples);
+    abort();
+  }
+
+  if (!HeapProfile::has_samples())
+    abort();
+
+  // Sampling off: nothing new is recorded, but live samples stay tracked.
+  HeapProfile::set_interval(0);
+
+  for (size_t i = 0; i < OBJECT_COUNT / 2; i++)
+    a->dealloc(objects[i]);
+
+  size_t remaining = dump_and_count();
+  if ((remaining == 0) || (remaining >= samples))
+    abort();
+
+  for (size_t i = OBJECT_COUNT / 2; i < OBJECT_COUNT; i++)
+    a->dealloc(objects[i], OBJECT_SIZE);
+
+  if (HeapProfile::has_samples())
+    abort();
+  if (dump_and_count() != 0)
+    abort();
+
+  return 0;
+}
@@ -0,0 +1,91 @@
+/**
+ * Checks the slow path latency histograms, which are maintained even when
+ * snmalloc is built without `USE_SNMALLOC_STATS`.
+ */
+#undef USE_SNMALLOC_STATS
+
+#include <snmalloc.h>
+#include <test/setup.h>
+#include <vector>
+
+using namespace snmalloc;
+
+static constexpr size_t OBJECT_SIZE = 48;
+static constexpr size_t OBJECT_COUNT = 10000;
+static constexpr size_t LARGE_SIZE = 2 * SUPERSLAB_SIZE;
+
+int main()
+{
+  setup();
+
+  // Bucketing is by the position of the most significant bit.
+  if (TickHistogram<>::bucket(0) != 0)
+    abort();
+  if (TickHistogram<>::bucket(1) != 1)
+    abort();
+  if (TickHistogram<>::bucket(1000) != 10)
+    abort();
+  if (TickHistogram<>::bucket(1024) != 11)
+    abort();
+
+  TickHistogram<> h;
+  for (size_t i = 0; i < 99; i++)
+    h.record(100);
+  h.record(5000);
+  if (h.count() != 100)
+    abort();
+  if (h.percentile(50) != 127)
+    abort();
+  if (h.percentile(100) != 8191)
+    abort();
+
+  auto* pool = current_alloc_pool();
+  Alloc* owner = pool->acquire();
+  Alloc* other = pool->acquire();
+
+  std::vector<void*> objects;
+  for (size_t i = 0; i < OBJECT_COUNT; i++)
+    objects.push_back(owner->alloc(OBJECT_SIZE));
+  void* large = owner->alloc(LARGE_SIZE);
+
+  auto& stats = owner->stats();
+  if (stats.alloc_slab_latency.count() == 0)
+    abort();
+  if (stats.large_alloc_latency.count() == 0)
+    abort();
+
+  // Every remote deallocation batch is handled by the owner's message queue.
+  for (void* p : objects)
+    other->dealloc(p);
+  other->flush_remote();
+  owner->handle_message_queue();
+  if (stats.message_queue_latency.count() == 0)
+    abort();
+
+  owner->dealloc(large);
+
+  auto& provider = default_memory_provider();
+  if (provider.reserve_latency.count() == 0)
+    abort();
+
+  // A second large allocation of the same size reuses the cached chunk, and
+  // so tells the platform that it is in use again.
+  size_t notified = provider.notify_using_latency.count();
+  large = owner->alloc(LARGE_SIZE);
+  owner->dealloc(large);
+  if (provider.notify_using_latency.count() <= notified)
+    abort();
+
+  pool->release(owner);
+  pool->release(other);
+  pool->debug_check_empty();
+
+  Stats s;
+  pool->aggregate_stats(s);
+  if (s.alloc_slab_latency.count() < stats.alloc_slab_latency.count())
+    abort();
+  if (s.message_queue_latency.count() < stats.message_queue_latency.count())
+    abort();
+
+  return 0;
+}
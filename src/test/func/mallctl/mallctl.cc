@@ -0,0 +1,227 @@
+/**
+ * Exercises the `mallctl` control interface through the C ABI.
+ */
+#include <string>
+#include <test/setup.h>
+
+#define SNMALLOC_NAME_MANGLE(a) our_##a
+#include "../../../override/malloc.cc"
+
+using namespace snmalloc;
+
+static size_t read_size(const char* name)
+{
+  size_t value = 0;
+  size_t len = sizeof(value);
+  if (our_mallctl(name, &value, &len, nullptr, 0) != 0)
+    abort();
+  return value;
+}
+
+static void test_errors()
+{
+  size_t value = 0;
+  size_t len = sizeof(value);
+
+  if (our_mallctl("snmalloc.missing", &value, &len, nullptr, 0) != ENOENT)
+    abort();
+  if (
+    our_mallctl("snmalloc.sizeclass.100000.size", &value, &len, nullptr, 0) !=
+    ENOENT)
+    abort();
+
+  // Statistics are read-only.
+  if (
+    our_mallctl("stats.active", &value, &len, &value, sizeof(value)) != EPERM)
+    abort();
+
+  // The size of the output must match.
+  uint32_t small = 0;
+  len = sizeof(small);
+  if (our_mallctl("stats.active", &small, &len, nullptr, 0) != EINVAL)
+    abort();
+
+  // Epoch can be advanced.
+  uint64_t epoch = 1;
+  len = sizeof(epoch);
+  if (our_mallctl("epoch", &epoch, &len, &epoch, sizeof(epoch)) != 0)
+    abort();
+}
+
+static void test_stats()
+{
+  size_t sc = size_to_sizeclass(128);
+  std::string name = "snmalloc.sizeclass." + std::to_string(sc) + ".";
+
+  if (read_size((name + "size").c_str()) != sizeclass_to_size(sc))
+    abort();
+
+  size_t before = read_size((name + "slabs").c_str());
+  void* p = our_malloc(128);
+  size_t after = read_size((name + "slabs").c_str());
+  if (after != before + 1)
+    abort();
+
+  if (read_size("stats.active") == 0)
+    abort();
+  if (read_size("stats.resident") < read_size("stats.active"))
+    abort();
+  if (read_size("stats.mapped") < read_size("stats.resident"))
+    abort();
+
+  size_t allocated = 0;
+  size_t len = sizeof(allocated);
+  if (our_mallctl("stats.allocated", &allocated, &len, nullptr, 0) != ENOENT)
+    abort();
+
+  if (read_size("snmalloc.sizeclasses") != NUM_SIZECLASSES)
+    abort();
+
+  our_free(p);
+}
+
+static void test_large_cache()
+{
+  // Large allocations are cached in the memory provider when freed.
+  size_t size = large_sizeclass_to_size(1);
+  size_t before = read_size("snmalloc.large_class.1.cached");
+  void* p = our_malloc(size);
+  our_free(p);
+
+  if (read_size("snmalloc.large_class.1.size") != size)
+    abort();
+  if (read_size("snmalloc.large_class.1.cached") != before + 1)
+    abort();
+  if (read_size("snmalloc.stats.available_large_chunks") < size)
+    abort();
+
+  if (our_mallctl("arena.4096.purge", nullptr, nullptr, nullptr, 0) != 0)
+    abort();
+  if (our_mallctl("snmalloc.decommit", nullptr, nullptr, nullptr, 0) != 0)
+    abort();
+  if (
+    our_mallctl("snmalloc.cleanup_unused", nullptr, nullptr, nullptr, 0) != 0)
+    abort();
+  if (our_mallctl("thread.tcache.flush", nullptr, nullptr, nullptr, 0) != 0)
+    abort();
+
+  // Decommitted chunks are still reusable.
+  p = our_calloc(1, size);
+  for (size_t i = 0; i < size; i += OS_PAGE_SIZE)
+  {
+    if (static_cast<char*>(p)[i] != 0)
+      abort();
+  }
+  our_free(p);
+}
+
+static void test_latency()
+{
+  void* p = our_malloc(2 * SUPERSLAB_SIZE);
+  our_free(p);
+
+  size_t buckets = read_size("snmalloc.latency.buckets");
+  size_t calls = 0;
+  size_t thread_calls = 0;
+  size_t reserves = 0;
+  for (size_t i = 0; i < buckets; i++)
+  {
+    std::string bucket = "bucket." + std::to_string(i) + ".";
+    calls += read_size(("snmalloc.latency." + bucket + "large_alloc").c_str());
+    thread_calls += read_size(
+      ("snmalloc.thread.latency." + bucket + "large_alloc").c_str());
+    reserves += read_size(("snmalloc.latency." + bucket + "reserve").c_str());
+  }
+  if ((calls == 0) || (thread_calls == 0) || (thread_calls > calls))
+    abort();
+  if (reserves == 0)
+    abort();
+
+  size_t value = 0;
+  size_t len = sizeof(value);
+  std::string past_end =
+    "snmalloc.latency.bucket." + std::to_string(buckets) + ".reserve";
+  if (our_mallctl(past_end.c_str(), &value, &len, nullptr, 0) != ENOENT)
+    abort();
+  // The memory provider is shared, so has no per-thread histograms.
+  if (
+    our_mallctl(
+      "snmalloc.thread.latency.bucket.0.reserve", &value, &len, nullptr, 0) !=
+    ENOENT)
+    abort();
+}
+
+static void test_opts()
+{
+  size_t budget = read_size("snmalloc.opt.remote_cache_budget");
+  if (budget != REMOTE_CACHE)
+    abort();
+
+  size_t new_budget = 4096;
+  if (
+    our_mallctl(
+      "snmalloc.opt.remote_cache_budget",
+      nullptr,
+      nullptr,
+      &new_budget,
+      sizeof(new_budget)) != 0)
+    abort();
+  if (read_size("snmalloc.opt.remote_cache_budget") != new_budget)
+    abort();
+
+  unsigned policy = 0;
+  size_t len = sizeof(policy);
+  if (
+    our_mallctl("snmalloc.opt.decommit_policy", &policy, &len, nullptr, 0) !=
+    0)
+    abort();
+  if (policy != decommit_strategy)
+    abort();
+
+  unsigned none = DecommitNone;
+  if (
+    our_mallctl(
+      "snmalloc.opt.decommit_policy", nullptr, nullptr, &none, sizeof(none)) !=
+    0)
+    abort();
+
+  // Memory cached without decommitting is reused correctly.
+  void* p = our_malloc(large_sizeclass_to_size(1));
+  our_free(p);
+  p = our_calloc(1, large_sizeclass_to_size(1));
+  if (static_cast<char*>(p)[OS_PAGE_SIZE] != 0)
+    abort();
+  our_free(p);
+
+  unsigned invalid = 17;
+  if (
+    our_mallctl(
+      "snmalloc.opt.decommit_policy",
+      nullptr,
+      nullptr,
+      &invalid,
+      sizeof(invalid)) != EINVAL)
+    abort();
+
+  if (
+    our_mallctl(
+      "snmalloc.opt.decommit_policy",
+      nullptr,
+      nullptr,
+      &policy,
+      sizeof(policy)) != 0)
+    abort();
+}
+
+int main()
+{
+  setup();
+
+  test_errors();
+  test_stats();
+  test_large_cache();
+  test_latency();
+  test_opts();
+
+  return 0;
+}
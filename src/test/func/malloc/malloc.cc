@@ -79,7 +79,11 @@ void test_realloc(void* p, size_t size, int err, bool null)
 {
   size_t old_size = 0;
   if (p != nullptr)
+  {
     old_size = our_malloc_usable_size(p);
+    for (size_t i = 0; i < old_size; i++)
+      static_cast<uint8_t*>(p)[i] = static_cast<uint8_t>(i * 7);
+  }
 
   fprintf(
     stderr, "realloc(%p(%" ST_FMT "u), %" ST_FMT "u)\n", p, old_size, size);
@@ -88,6 +92,19 @@ void test_realloc(void* p, size_t size, int err, bool null)
   // Realloc failure case, deallocate original block
   if (new_p == nullptr && size != 0)
     our_free(p);
+
+  // The contents are kept, up to the smaller of the two sizes.
+  if (new_p != nullptr)
+  {
+    for (size_t i = 0; i < bits::min(old_size, size); i++)
+    {
+      if (static_cast<uint8_t*>(new_p)[i] != static_cast<uint8_t>(i * 7))
+      {
+        printf("Realloc lost contents at offset %" ST_FMT "u\n", i);
+        abort();
+      }
+    }
+  }
   check_result(size, 1, new_p, err, null);
 }
 
@@ -195,6 +212,8 @@ int main(int argc, char** argv)
     test_posix_memalign(0, align + 1, EINVAL, true);
   }
 
+  our_snmalloc_flush();
+
   current_alloc_pool()->debug_check_empty();
   return 0;
 }
@@ -0,0 +1,121 @@
+/**
+ * Checks that free medium objects above the decommit threshold have their
+ * pages decommitted, accounted as such and, with `MADV_FREE`, returned to
+ * Linux, while the rest of the mediumslab is in use, and that they are
+ * usable and zeroed as requested when they are reused.
+ */
+#ifndef USE_MEDIUM_DECOMMIT_THRESHOLD
+#  define USE_MEDIUM_DECOMMIT_THRESHOLD (64 * 1024)
+#endif
+
+#include <snmalloc.h>
+#include <stdio.h>
+#include <string.h>
+#include <test/setup.h>
+
+using namespace snmalloc;
+
+// Three of these fit in a mediumslab, with page aligned interiors.
+static constexpr size_t SIZE = SUPERSLAB_SIZE / 4;
+
+/**
+ * Bytes of memory that the kernel may reclaim lazily, or SIZE_MAX if the
+ * PAL does not use `MADV_FREE` or this is not reported.
+ */
+static size_t lazy_free_bytes()
+{
+  size_t kib = SIZE_MAX;
+#if defined(__linux__) && defined(USE_LINUX_MADV_FREE) && defined(MADV_FREE)
+  FILE* f = fopen("/proc/self/smaps_rollup", "r");
+  if (f == nullptr)
+    return kib;
+
+  char line[256];
+  while (fgets(line, sizeof(line), f) != nullptr)
+  {
+    unsigned long value;
+    if (sscanf(line, "LazyFree: %lu kB", &value) == 1)
+      kib = value;
+  }
+  fclose(f);
+#endif
+  return (kib == SIZE_MAX) ? kib : kib * 1024;
+}
+
+static void check(void* p, uint8_t value)
+{
+  auto* bytes = static_cast<uint8_t*>(p);
+  for (size_t i = 0; i < SIZE; i++)
+  {
+    if (bytes[i] != value)
+      abort();
+  }
+}
+
+int main()
+{
+  setup();
+
+  auto* a = ThreadAlloc::get();
+  auto& provider = default_memory_provider();
+  DecommitStrategy policy = provider.decommit_policy;
+  provider.decommit_policy = DecommitSuper;
+
+  void* objects[3];
+  for (auto& p : objects)
+  {
+    p = a->alloc(SIZE);
+    memset(p, 0xff, SIZE);
+  }
+
+  // The object's pages are all its own, and are accounted as decommitted.
+  // The kernel may not report every page returned to it, for example if
+  // some were backed by a huge page.
+  size_t before = provider.decommitted_bytes;
+  size_t lazy_before = lazy_free_bytes();
+  a->dealloc(objects[1]);
+  if (
+    (provider.decommitted_bytes != before + SIZE) ||
+    (provider.medium_decommitted_bytes != SIZE))
+    abort();
+  size_t lazy_after = lazy_free_bytes();
+  if ((lazy_before != SIZE_MAX) && (lazy_after < lazy_before + SIZE / 2))
+    abort();
+
+  // The recommitted object is zeroed on request, and otherwise writable.
+  objects[1] = a->alloc<YesZero>(SIZE);
+  if (
+    (provider.decommitted_bytes != before) ||
+    (provider.medium_decommitted_bytes != 0))
+    abort();
+  check(objects[1], 0);
+  memset(objects[1], 0xff, SIZE);
+  a->dealloc(objects[1]);
+  objects[1] = a->alloc(SIZE);
+  memset(objects[1], 0x55, SIZE);
+  check(objects[1], 0x55);
+  check(objects[0], 0xff);
+  check(objects[2], 0xff);
+
+  // Objects decommitted while the policy decommits whole chunks are
+  // recommitted when the chunk is kept committed instead.
+  a->dealloc(objects[1]);
+  provider.decommit_policy = DecommitNone;
+  a->dealloc(objects[0]);
+  a->dealloc(objects[2]);
+
+  void* small[64];
+  for (auto& p : small)
+  {
+    p = a->alloc(SLAB_SIZE / 2);
+    memset(p, 0xff, SLAB_SIZE / 2);
+  }
+  for (auto& p : small)
+    a->dealloc(p);
+
+  if (provider.medium_decommitted_bytes != 0)
+    abort();
+
+  provider.decommit_policy = policy;
+  return 0;
+}
@@ -4,6 +4,7 @@
 #include <test/setup.h>
 #include <test/xoroshiro.h>
 #include <unordered_set>
+#include <vector>
 #if defined(__linux__) && !defined(SNMALLOC_QEMU_WORKAROUND)
 /*
  * We only test allocations with limited AS on linux for now.
@@ -377,6 +378,67 @@ void test_calloc_large_bug()
   alloc->dealloc(p1);
 }
 
+void test_alloc_aligned()
+{
+  auto alloc = ThreadAlloc::get();
+
+  for (size_t align = 1; align <= SUPERSLAB_SIZE; align <<= 1)
+  {
+    size_t step = bits::max<size_t>(1, align / 4) + 1;
+    for (size_t size = 0; size <= 4 * align + 64; size += step)
+    {
+      void* p = alloc->alloc_aligned(align, size);
+      if ((address_cast(p) & (align - 1)) != 0)
+        abort();
+
+      // The allocation uses the smallest sizeclass whose stride is a
+      // multiple of the alignment.
+      size_t expected = round_size(size == 0 ? 1 : size);
+      while ((expected & (align - 1)) != 0)
+        expected = round_size(expected + 1);
+      if (Alloc::alloc_size(p) != expected)
+        abort();
+
+      alloc->dealloc(p);
+    }
+  }
+
+  void* p = alloc->alloc_aligned<64>(80);
+  if ((address_cast(p) & 63) != 0)
+    abort();
+  alloc->dealloc(p);
+}
+
+void test_medium_lowest_first()
+{
+  auto alloc = ThreadAlloc::get();
+  size_t size = SLAB_SIZE * 3;
+  size_t count = medium_slab_free(size_to_sizeclass(size));
+  std::vector<void*> objects(count);
+
+  // A new mediumslab hands out its objects in address order.
+  for (size_t i = 0; i < count; i++)
+  {
+    objects[i] = alloc->alloc(size);
+    if ((i > 0) && (objects[i] != pointer_offset(objects[i - 1], size)))
+      abort();
+  }
+
+  // Freed objects are reused lowest first, whatever order they were freed
+  // in.
+  alloc->dealloc(objects[3]);
+  alloc->dealloc(objects[1]);
+  alloc->dealloc(objects[2]);
+  for (size_t i = 1; i <= 3; i++)
+  {
+    if (alloc->alloc(size) != objects[i])
+      abort();
+  }
+
+  for (auto p : objects)
+    alloc->dealloc(p);
+}
+
 int main(int argc, char** argv)
 {
   setup();
@@ -413,5 +475,7 @@ int main(int argc, char** argv)
   test_external_pointer();
   test_alloc_16M();
   test_calloc_16M();
+  test_alloc_aligned();
+  test_medium_lowest_first();
   return 0;
 }
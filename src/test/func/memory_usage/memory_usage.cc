@@ -72,6 +72,53 @@ void remove_n_allocs(size_t n)
   }
 }
 
+/**
+ * Check the breakdown reported by malloc_info_v2 as objects of each kind are
+ * allocated and freed.
+ */
+void check_malloc_info_v2()
+{
+  malloc_info_v2 before;
+  get_malloc_info_v2(&before);
+
+  if (before.metadata_bytes == 0)
+    abort();
+
+  size_t large_size = 4 * SUPERSLAB_SIZE;
+  void* small = our_malloc(16);
+  void* medium = our_malloc(SUPERSLAB_SIZE / 4);
+  void* large = our_malloc(large_size);
+
+  malloc_info_v2 during;
+  get_malloc_info_v2(&during);
+
+  if (during.small_bytes < SUPERSLAB_SIZE)
+    abort();
+  if (during.medium_bytes < SUPERSLAB_SIZE)
+    abort();
+  if (during.large_bytes != before.large_bytes + large_size)
+    abort();
+
+  our_free(large);
+  our_free(medium);
+  our_free(small);
+
+  malloc_info_v2 after;
+  get_malloc_info_v2(&after);
+
+  if (after.large_bytes != before.large_bytes)
+    abort();
+  if (after.cached_bytes + after.decommitted_bytes < large_size)
+    abort();
+
+  std::cout << "malloc_info_v2: small " << after.small_bytes << ", medium "
+            << after.medium_bytes << ", large " << after.large_bytes
+            << ", cached " << after.cached_bytes << ", decommitted "
+            << after.decommitted_bytes << ", unused reserved "
+            << after.unused_reserved_bytes << ", metadata "
+            << after.metadata_bytes << std::endl;
+}
+
 int main(int argc, char** argv)
 {
   UNUSED(argc);
@@ -100,4 +147,6 @@ int main(int argc, char** argv)
 
   remove_n_allocs(3);
   std::cout << "Teardown complete!" << std::endl;
+
+  check_malloc_info_v2();
 }
@@ -0,0 +1,53 @@
+/**
+ * Checks that the pool hands out the released allocator with the most memory
+ * ready to reuse, rather than simply the most recently released one, and
+ * that the allocators passed over stay available.
+ */
+#include <snmalloc.h>
+#include <test/setup.h>
+#include <vector>
+
+using namespace snmalloc;
+
+int main()
+{
+  setup();
+
+  auto* pool = current_alloc_pool();
+  Alloc* warm = pool->acquire();
+  Alloc* cold = pool->acquire();
+
+  // Leave partially used slabs and free lists in many sizeclasses.
+  std::vector<void*> objects;
+  for (size_t size = 16; size <= 4096; size += 16)
+  {
+    objects.push_back(warm->alloc(size));
+    objects.push_back(warm->alloc(size));
+  }
+  for (size_t i = 0; i < objects.size(); i += 2)
+    warm->dealloc(objects[i]);
+
+  if (warm->reuse_score() <= cold->reuse_score())
+    abort();
+
+  // The cold allocator is released last, so is on top of the free stack.
+  pool->release(warm);
+  pool->release(cold);
+
+  Alloc* a = pool->acquire();
+  if (a != warm)
+    abort();
+
+  // The cold allocator was put back rather than lost or replaced.
+  Alloc* b = pool->acquire();
+  if (b != cold)
+    abort();
+
+  for (size_t i = 1; i < objects.size(); i += 2)
+    a->dealloc(objects[i]);
+
+  pool->release(b);
+  pool->release(a);
+  pool->debug_check_empty();
+  return 0;
+}
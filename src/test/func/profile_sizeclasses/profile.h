@@ -0,0 +1,4 @@
+// A profile with spikes between the default sizeclasses, in the format of
+// the `high` and `count` columns of the `AllocSizes` statistics.
+{16, 200}, {48, 1000}, {72, 500}, {136, 800},
+{256, 100}, {520, 400}, {600, 300},
@@ -0,0 +1,63 @@
+/**
+ * Checks that the sizeclasses added for an allocation profile are merged
+ * into the ladder, and that objects of every sizeclass keep their alignment
+ * and can be found from interior pointers.
+ */
+#define SNMALLOC_SIZECLASS_PROFILE "test/func/profile_sizeclasses/profile.h"
+
+#include <snmalloc.h>
+#include <test/setup.h>
+
+using namespace snmalloc;
+
+int main()
+{
+  setup();
+
+  // 48 and 80 are already sizeclasses, 144 and 528 are added, and 608 is
+  // not as rounding 576 up to it would lose the 64 byte alignment.
+  static_assert(NUM_PROFILE_CLASSES == 2);
+  if (round_size(48) != 48 || round_size(72) != 80)
+    abort();
+  if (round_size(136) != 144 || round_size(145) != 160)
+    abort();
+  if (round_size(520) != 528 || round_size(600) != 640)
+    abort();
+  if (size_to_sizeclass_const(144) != size_to_sizeclass(144))
+    abort();
+
+  size_t prev = 0;
+  for (sizeclass_t sc = 0; sc < NUM_SIZECLASSES; sc++)
+  {
+    size_t size = sizeclass_to_size(sc);
+    if (size <= prev)
+      abort();
+    if (size_to_sizeclass(prev + 1) != sc || size_to_sizeclass(size) != sc)
+      abort();
+    prev = size;
+
+    for (size_t offset = 0; offset < SUPERSLAB_SIZE; offset += 8)
+    {
+      if (round_by_sizeclass(size, offset) != (offset / size) * size)
+        abort();
+      if (is_multiple_of_sizeclass(size, offset) != ((offset % size) == 0))
+        abort();
+    }
+  }
+
+  auto* a = ThreadAlloc::get();
+  for (size_t size = 1; size <= 2 * SLAB_SIZE; size += 8)
+  {
+    size_t align = size & (~size + 1);
+    void* p = a->alloc(size);
+    if ((address_cast(p) & (bits::min(align, OS_PAGE_SIZE) - 1)) != 0)
+      abort();
+    if (a->alloc_size(p) != round_size(size))
+      abort();
+    if (a->external_pointer(pointer_offset(p, size - 1)) != p)
+      abort();
+    a->dealloc(p, size);
+  }
+
+  return 0;
+}
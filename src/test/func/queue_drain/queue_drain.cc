@@ -0,0 +1,131 @@
+/**
+ * Checks that deallocations queued for an allocator that is not owned by any
+ * thread are processed by other threads, either once the queue grows too
+ * large or periodically from their slow paths, and that allocators owned by a
+ * thread are left alone.
+ */
+#include <snmalloc.h>
+#include <test/setup.h>
+#include <vector>
+
+using namespace snmalloc;
+
+static constexpr size_t OBJECT_SIZE = 1024;
+
+std::vector<void*> fill(Alloc* a, size_t bytes)
+{
+  std::vector<void*> objects;
+  for (size_t i = 0; i < bytes / OBJECT_SIZE; i++)
+    objects.push_back(a->alloc(OBJECT_SIZE));
+  return objects;
+}
+
+void free_all(Alloc* a, std::vector<void*>& objects)
+{
+  for (auto p : objects)
+    a->dealloc(p);
+  a->flush_remote();
+}
+
+/**
+ * An explicit drain must skip an allocator that is in use, and process the
+ * queue of one that has been released.
+ */
+void test_explicit_drain()
+{
+  auto* pool = current_alloc_pool();
+  Alloc* owner = pool->acquire();
+  Alloc* other = pool->acquire();
+
+  auto first = fill(owner, 1 << 20);
+  auto second = fill(owner, 1 << 20);
+
+  free_all(other, first);
+  size_t queued = owner->remote_queued_bytes();
+  if (queued < first.size() * OBJECT_SIZE)
+    abort();
+
+  pool->drain_overloaded(1);
+  if (owner->remote_queued_bytes() != queued)
+    abort();
+
+  // Releasing processes the queue.  The final message stays in the queue as
+  // its stub.
+  pool->release(owner);
+  if (owner->remote_queued_bytes() > OBJECT_SIZE)
+    abort();
+
+  free_all(other, second);
+  if (owner->remote_queued_bytes() < second.size() * OBJECT_SIZE)
+    abort();
+
+  pool->drain_overloaded(1);
+  if (owner->remote_queued_bytes() > OBJECT_SIZE)
+    abort();
+
+  pool->release(other);
+  pool->debug_check_empty();
+}
+
+/**
+ * Posting enough to a released allocator to cross the threshold drains it
+ * without any explicit call.
+ */
+void test_automatic_drain()
+{
+  auto* pool = current_alloc_pool();
+  Alloc* owner = pool->acquire();
+  Alloc* other = pool->acquire();
+
+  auto objects =
+    fill(owner, REMOTE_QUEUE_THRESHOLD + (REMOTE_QUEUE_THRESHOLD / 2));
+  pool->release(owner);
+  free_all(other, objects);
+
+  if (owner->remote_queued_bytes() >= REMOTE_QUEUE_THRESHOLD)
+    abort();
+
+  pool->release(other);
+  pool->debug_check_empty();
+}
+
+/**
+ * An allocator that keeps fetching new slabs periodically drains released
+ * allocators, even if their queues are small.
+ */
+void test_orphan_drain()
+{
+  auto* pool = current_alloc_pool();
+  Alloc* owner = pool->acquire();
+  Alloc* other = pool->acquire();
+
+  auto objects = fill(owner, 1 << 20);
+  pool->release(owner);
+  free_all(other, objects);
+
+  if (owner->remote_queued_bytes() < objects.size() * OBJECT_SIZE)
+    abort();
+
+  // Each of these takes a new slab.
+  std::vector<void*> slabs;
+  for (size_t i = 0; i < ORPHAN_DRAIN_INTERVAL * 16; i++)
+    slabs.push_back(other->alloc(SLAB_SIZE));
+
+  if (owner->remote_queued_bytes() > OBJECT_SIZE)
+    abort();
+
+  free_all(other, slabs);
+  pool->release(other);
+  pool->debug_check_empty();
+}
+
+int main()
+{
+  setup();
+
+  test_explicit_drain();
+  test_automatic_drain();
+  test_orphan_drain();
+
+  return 0;
+}
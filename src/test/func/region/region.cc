@@ -0,0 +1,114 @@
+/**
+ * Checks that a region allocates only from its buffer, and that `reset`
+ * makes the whole buffer available again.
+ */
+#include <mem/region.h>
+#include <snmalloc.h>
+#include <stdlib.h>
+#include <string.h>
+#include <test/setup.h>
+
+using namespace snmalloc;
+
+static constexpr size_t BUFFER_SIZE = 16 * SUPERSLAB_SIZE;
+static constexpr size_t LARGE_SIZE = 2 * SUPERSLAB_SIZE;
+
+static char* buffer;
+
+static void check_in_buffer(void* p, size_t size)
+{
+  if (p == nullptr)
+    abort();
+  if ((p < buffer) || (pointer_offset(p, size) > buffer + BUFFER_SIZE))
+    abort();
+}
+
+/**
+ * Allocate and fill large objects until the region is exhausted, and
+ * return how many fitted.
+ */
+static size_t fill_with_large(Region<>& region)
+{
+  size_t count = 0;
+  while (true)
+  {
+    void* p = region.alloc(LARGE_SIZE);
+    if (p == nullptr)
+      return count;
+    check_in_buffer(p, LARGE_SIZE);
+    memset(p, 0xff, LARGE_SIZE);
+    count++;
+  }
+}
+
+int main()
+{
+  setup();
+
+  // Deliberately not aligned to a page or chunk.
+  void* allocation = ThreadAlloc::get()->alloc(BUFFER_SIZE + 1);
+  buffer = static_cast<char*>(allocation) + 1;
+  void* outside = ThreadAlloc::get()->alloc(64);
+
+  // The buffer is itself a large allocation, whose pagemap entries the region
+  // must leave as it found them.
+  using ChunkMap = SNMALLOC_DEFAULT_CHUNKMAP;
+  static constexpr size_t CHUNKS = BUFFER_SIZE / SUPERSLAB_SIZE + 1;
+  uint8_t entries[CHUNKS];
+  for (size_t i = 0; i < CHUNKS; i++)
+    entries[i] = ChunkMap::get(address_cast(buffer + i * SUPERSLAB_SIZE));
+
+  {
+    Region<> region(buffer, BUFFER_SIZE);
+
+    void* objects[64];
+    for (size_t i = 0; i < 64; i++)
+    {
+      size_t size = 16 << (i % 12);
+      objects[i] = region.alloc(size);
+      check_in_buffer(objects[i], size);
+      memset(objects[i], 0xff, size);
+    }
+    for (size_t i = 0; i < 64; i += 2)
+      region.dealloc(objects[i]);
+
+    size_t first = fill_with_large(region);
+    if (first == 0)
+      abort();
+
+    // Rewinding makes the same space available, although the buffer is no
+    // longer zero.
+    region.reset();
+    size_t second = fill_with_large(region);
+    if (second < first)
+      abort();
+
+    region.reset();
+    if (fill_with_large(region) != second)
+      abort();
+
+    region.reset();
+    for (size_t size = 16; size <= LARGE_SIZE; size <<= 1)
+    {
+      auto* p = static_cast<uint8_t*>(
+        region.allocator()->alloc<YesZero>(size));
+      check_in_buffer(p, size);
+      for (size_t i = 0; i < size; i++)
+      {
+        if (p[i] != 0)
+          abort();
+      }
+    }
+  }
+
+  // The pagemap describes the buffer's own allocation again.
+  for (size_t i = 0; i < CHUNKS; i++)
+  {
+    if (ChunkMap::get(address_cast(buffer + i * SUPERSLAB_SIZE)) != entries[i])
+      abort();
+  }
+
+  ThreadAlloc::get()->dealloc(outside);
+  ThreadAlloc::get()->dealloc(allocation);
+  return 0;
+}
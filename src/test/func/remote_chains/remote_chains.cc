@@ -0,0 +1,77 @@
+/**
+ * Exercises the pre-linked remote deallocation protocol.  Objects are
+ * returned to their owning allocator by a second allocator, first in runs that
+ * can be spliced directly onto a slab's free list, and then in runs that free
+ * whole slabs.
+ */
+#ifndef USE_REMOTE_CHAINS
+#  define USE_REMOTE_CHAINS
+#endif
+
+#include <algorithm>
+#include <snmalloc.h>
+#include <test/setup.h>
+#include <test/xoroshiro.h>
+#include <vector>
+
+using namespace snmalloc;
+
+void test_remote_chains(size_t size, size_t count)
+{
+  auto* pool = current_alloc_pool();
+  Alloc* owner = pool->acquire();
+  Alloc* other = pool->acquire();
+
+  std::vector<void*> objects;
+  for (size_t i = 0; i < count; i++)
+    objects.push_back(owner->alloc(size));
+
+  // Shuffle so that consecutive remote frees hit different slabs, causing
+  // runs to be closed early.
+  xoroshiro::p128r64 r;
+  for (size_t i = objects.size() - 1; i > 0; i--)
+    std::swap(objects[i], objects[r.next() % (i + 1)]);
+
+  // Free every other object remotely, leaving the slabs partially used.
+  for (size_t i = 0; i < objects.size(); i += 2)
+    other->dealloc(objects[i]);
+
+  bool result;
+  pool->debug_check_empty(&result);
+  if (result != false)
+    abort();
+
+  // Free the rest in address order, which returns whole slabs.
+  std::vector<void*> rest;
+  for (size_t i = 1; i < objects.size(); i += 2)
+    rest.push_back(objects[i]);
+  std::sort(rest.begin(), rest.end());
+  for (auto p : rest)
+    other->dealloc(p);
+
+  pool->debug_check_empty();
+
+  pool->release(owner);
+  pool->release(other);
+}
+
+int main(int argc, char** argv)
+{
+  setup();
+  UNUSED(argc);
+  UNUSED(argv);
+
+  for (size_t size : {16, 32, 48, 64, 96, 256, 1024, 4096})
+    test_remote_chains(size, 10000);
+
+#ifdef USE_SNMALLOC_STATS
+  Stats s;
+  current_alloc_pool()->aggregate_stats(s);
+  if (s.remote_chains_received == 0)
+    abort();
+  if (s.average_remote_chain_length() <= 1.0)
+    abort();
+#endif
+
+  return 0;
+}
@@ -0,0 +1,163 @@
+/**
+ * Checks that two processes can allocate from a shared heap and free each
+ * other's objects.
+ */
+#include <snmalloc.h>
+#include <test/setup.h>
+
+#if defined(__linux__)
+#  include <mem/sharedheap.h>
+#  include <string.h>
+#  include <sys/wait.h>
+#  include <unistd.h>
+
+using namespace snmalloc;
+
+static constexpr size_t COUNT = 256;
+static constexpr size_t HEAP_SIZE = 32 * SUPERSLAB_SIZE;
+static constexpr size_t LARGE_SIZE = 2 * SUPERSLAB_SIZE;
+
+/**
+ * Objects exchanged between the processes, allocated in the heap.
+ */
+struct Mailbox
+{
+  void* from_parent[COUNT];
+  void* from_child[COUNT];
+  void* large;
+};
+
+static size_t object_size(size_t i)
+{
+  return 16 << (i % 10);
+}
+
+static void fill(void* p, size_t size, uint8_t value)
+{
+  memset(p, value, size);
+}
+
+static bool check(void* p, size_t size, uint8_t value)
+{
+  auto* bytes = static_cast<uint8_t*>(p);
+  for (size_t i = 0; i < size; i++)
+  {
+    if (bytes[i] != value)
+      return false;
+  }
+  return true;
+}
+
+/**
+ * Run in the child: reattach to the heap through its file descriptor, free
+ * the parent's objects and allocate some for the parent to free.
+ */
+static int child(SharedHeap<>* heap, int fd, Mailbox* mailbox)
+{
+  heap->detach();
+  auto* attached = SharedHeap<>::attach(fd);
+  if (attached != heap)
+    return 1;
+
+  auto* a = heap->acquire();
+
+  for (size_t i = 0; i < COUNT; i++)
+  {
+    if (!check(mailbox->from_parent[i], object_size(i), 0xaa))
+      return 2;
+    a->dealloc(mailbox->from_parent[i]);
+  }
+
+  if (!check(mailbox->large, LARGE_SIZE, 0xaa))
+    return 3;
+  a->dealloc(mailbox->large);
+
+  for (size_t i = 0; i < COUNT; i++)
+  {
+    mailbox->from_child[i] = a->alloc(object_size(i));
+    fill(mailbox->from_child[i], object_size(i), 0x55);
+  }
+
+  heap->release(a);
+  heap->detach();
+  return 0;
+}
+
+int main()
+{
+  setup();
+
+  int fd;
+  auto* heap = SharedHeap<>::create(HEAP_SIZE, &fd);
+  if (heap == nullptr)
+    abort();
+
+  // A process uses one shared heap at a time.
+  int second_fd;
+  if (SharedHeap<>::create(HEAP_SIZE, &second_fd) != nullptr)
+    abort();
+  if (SharedHeap<>::attach(fd) != nullptr)
+    abort();
+
+  auto* a = heap->acquire();
+  auto* mailbox = static_cast<Mailbox*>(a->alloc(sizeof(Mailbox)));
+  for (size_t i = 0; i < COUNT; i++)
+  {
+    mailbox->from_parent[i] = a->alloc(object_size(i));
+    fill(mailbox->from_parent[i], object_size(i), 0xaa);
+  }
+  mailbox->large = a->alloc(LARGE_SIZE);
+  fill(mailbox->large, LARGE_SIZE, 0xaa);
+
+  // Objects in the heap are only the heap's.
+  void* local = ThreadAlloc::get()->alloc(64);
+  using SharedChunkMap = DefaultChunkMap<SharedPagemapProvider>;
+  if (SharedChunkMap::get(local) != CMNotOurs)
+    abort();
+  if (SNMALLOC_DEFAULT_CHUNKMAP::get(mailbox) != CMNotOurs)
+    abort();
+  ThreadAlloc::get()->dealloc(local);
+
+  pid_t pid = fork();
+  if (pid < 0)
+    abort();
+  if (pid == 0)
+    _exit(child(heap, fd, mailbox));
+
+  int status;
+  if (waitpid(pid, &status, 0) != pid)
+    abort();
+  if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+    abort();
+
+  // The child's frees of small and medium objects are waiting in this
+  // allocator's message queue, and the large allocation has been credited
+  // back to it.
+  size_t queued = a->remote_queued_bytes();
+  if (queued < COUNT * 16)
+    abort();
+  if (a->memory_usage().large_bytes != 0)
+    abort();
+  a->flush_remote();
+  if (a->remote_queued_bytes() >= queued)
+    abort();
+
+  for (size_t i = 0; i < COUNT; i++)
+  {
+    if (!check(mailbox->from_child[i], object_size(i), 0x55))
+      abort();
+    a->dealloc(mailbox->from_child[i]);
+  }
+  a->dealloc(mailbox);
+
+  heap->release(a);
+  heap->detach();
+  close(fd);
+  return 0;
+}
+#else
+int main()
+{
+  return 0;
+}
+#endif
@@ -0,0 +1,70 @@
+/**
+ * Checks the per-sizeclass slow path counters, which are maintained even
+ * when snmalloc is built without `USE_SNMALLOC_STATS`.
+ */
+#undef USE_SNMALLOC_STATS
+
+#include <snmalloc.h>
+#include <test/setup.h>
+#include <vector>
+
+using namespace snmalloc;
+
+static constexpr size_t OBJECT_SIZE = 48;
+static constexpr size_t OBJECT_COUNT = 10000;
+
+int main()
+{
+  setup();
+
+  auto* pool = current_alloc_pool();
+  Alloc* owner = pool->acquire();
+  Alloc* other = pool->acquire();
+
+  sizeclass_t sc = size_to_sizeclass(OBJECT_SIZE);
+  std::vector<void*> objects;
+
+  for (size_t i = 0; i < OBJECT_COUNT; i++)
+    objects.push_back(owner->alloc(OBJECT_SIZE));
+
+  auto& counters = owner->stats().counters[sc];
+
+  // Every allocation was supplied by a refill.
+  if (counters.refills == 0)
+    abort();
+  if (counters.refilled_objects < OBJECT_COUNT)
+    abort();
+  if (counters.current_slabs() == 0)
+    abort();
+
+  // Free half locally, and half from another allocator.
+  for (size_t i = 0; i < OBJECT_COUNT; i++)
+  {
+    if ((i & 1) == 0)
+      owner->dealloc(objects[i]);
+    else
+      other->dealloc(objects[i]);
+  }
+
+  other->flush_remote();
+  owner->flush_remote();
+
+  if (other->stats().remote_posts == 0)
+    abort();
+
+  pool->release(owner);
+  pool->release(other);
+  pool->debug_check_empty();
+
+  Stats s;
+  pool->aggregate_stats(s);
+
+  if (s.counters[sc].remote_received != OBJECT_COUNT / 2)
+    abort();
+
+  // Everything has been returned, so all slabs have been released.
+  if (s.counters[sc].current_slabs() != 0)
+    abort();
+
+  return 0;
+}
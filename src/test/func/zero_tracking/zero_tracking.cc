@@ -0,0 +1,118 @@
+/**
+ * Checks that objects known to be zero, either fresh small objects or free
+ * medium objects zeroed ahead of time, are handed out by zeroed allocations
+ * without being cleared again, and that objects written after being handed
+ * out are cleared.
+ */
+#ifndef USE_ZERO_TRACKING
+#  define USE_ZERO_TRACKING
+#endif
+
+// Free medium objects stay committed, so that they can be zeroed ahead of
+// time.
+#undef USE_MEDIUM_DECOMMIT_THRESHOLD
+#define USE_MEDIUM_DECOMMIT_THRESHOLD 0
+
+#include <snmalloc.h>
+#include <string.h>
+#include <test/setup.h>
+
+using namespace snmalloc;
+
+// Larger than a slab, so served from a mediumslab.
+static constexpr size_t SIZE = SUPERSLAB_SIZE / 16;
+
+// Enough small objects to use several fresh slabs.
+static constexpr size_t SMALL_SIZE = 48;
+static constexpr size_t SMALL_COUNT = 4 * SLAB_SIZE / SMALL_SIZE;
+
+static void check_zero(void* p, size_t size = SIZE)
+{
+  auto* bytes = static_cast<uint8_t*>(p);
+  for (size_t i = 0; i < size; i++)
+  {
+    if (bytes[i] != 0)
+      abort();
+  }
+}
+
+void test_small(Alloc* a)
+{
+  static void* objects[SMALL_COUNT];
+
+  for (size_t round = 0; round < 2; round++)
+  {
+    for (size_t i = 0; i < SMALL_COUNT; i++)
+    {
+      objects[i] = a->alloc<YesZero>(SMALL_SIZE);
+      check_zero(objects[i], SMALL_SIZE);
+      memset(objects[i], 0xff, SMALL_SIZE);
+    }
+
+    // The second round reuses the written objects.
+    for (size_t i = 0; i < SMALL_COUNT; i++)
+      a->dealloc(objects[i]);
+  }
+}
+
+void test_medium(Alloc* a)
+{
+  // Keeps the mediumslab from being returned when the object is freed.
+  void* keep = a->alloc(SIZE);
+
+  void* p = a->alloc<YesZero>(SIZE);
+  check_zero(p);
+  memset(p, 0xff, SIZE);
+  a->dealloc(p);
+
+  // The freed object is no longer known to be zero, so a zeroed allocation
+  // must clear it.
+  void* q = a->alloc<YesZero>(SIZE);
+  if (q != p)
+    abort();
+  check_zero(q);
+  memset(q, 0xff, SIZE);
+  a->dealloc(q);
+
+  // Zeroing ahead of time clears it, and only once.
+  if (a->zero_free_objects() < SIZE)
+    abort();
+  check_zero(p);
+  if (a->zero_free_objects() != 0)
+    abort();
+
+  // It is then handed out without being cleared, and is dirty again once
+  // written.
+  q = a->alloc<YesZero>(SIZE);
+  if (q != p)
+    abort();
+  check_zero(q);
+  memset(q, 0xff, SIZE);
+  a->dealloc(q);
+  q = a->alloc<YesZero>(SIZE);
+  check_zero(q);
+  a->dealloc(q);
+
+  // A budget limits how much is zeroed.
+  p = a->alloc<NoZero>(SIZE);
+  memset(p, 0xff, SIZE);
+  a->dealloc(p);
+  if (a->zero_free_objects(SIZE - 1) != 0)
+    abort();
+
+  a->dealloc(keep);
+}
+
+int main()
+{
+  setup();
+
+  auto* pool = current_alloc_pool();
+  Alloc* a = pool->acquire();
+
+  test_small(a);
+  test_medium(a);
+
+  pool->release(a);
+  return 0;
+}
@@ -0,0 +1,95 @@
+/**
+ * Measures false sharing between small objects allocated one after another
+ * and then used by different threads.  With `USE_FREE_LIST_SPREAD`, such
+ * objects are on distinct cache lines; this is compared with objects packed
+ * together, as a free list in address order hands them out.
+ */
+#ifndef USE_FREE_LIST_SPREAD
+#  define USE_FREE_LIST_SPREAD 64
+#endif
+
+#include <atomic>
+#include <snmalloc.h>
+#include <test/measuretime.h>
+#include <test/setup.h>
+#include <thread>
+#include <vector>
+
+using namespace snmalloc;
+
+static constexpr size_t THREADS = 4;
+static constexpr size_t OBJECT_SIZE = 16;
+static constexpr size_t CHECKED_OBJECTS = 4 * SLAB_SIZE / OBJECT_SIZE;
+
+#ifdef NDEBUG
+static constexpr size_t ITERATIONS = 1 << 24;
+#else
+static constexpr size_t ITERATIONS = 1 << 18;
+#endif
+
+/**
+ * Have each thread update its own object.
+ */
+NOINLINE void run(void** objects)
+{
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < THREADS; t++)
+  {
+    threads.emplace_back([object = objects[t]]() {
+      auto* counter = static_cast<std::atomic<size_t>*>(object);
+      for (size_t i = 0; i < ITERATIONS; i++)
+        counter->fetch_add(1, std::memory_order_relaxed);
+    });
+  }
+
+  for (auto& thread : threads)
+    thread.join();
+}
+
+int main()
+{
+  setup();
+
+  auto* pool = current_alloc_pool();
+  Alloc* a = pool->acquire();
+
+  // Objects allocated one after another from new free lists, enough to
+  // span several lists and slabs.
+  std::vector<void*> objects;
+  for (size_t i = 0; i < CHECKED_OBJECTS; i++)
+    objects.push_back(a->alloc(OBJECT_SIZE));
+
+  for (size_t i = 1; i < objects.size(); i++)
+  {
+    size_t distance = objects[i] > objects[i - 1] ?
+      pointer_diff(objects[i - 1], objects[i]) :
+      pointer_diff(objects[i], objects[i - 1]);
+    if (distance < CACHELINE_SIZE)
+      abort();
+  }
+
+  void* spread[THREADS];
+  for (size_t t = 0; t < THREADS; t++)
+  {
+    spread[t] = objects[t];
+    new (spread[t]) std::atomic<size_t>(0);
+  }
+
+  // The same number of objects in address order.
+  void* block = a->alloc(OBJECT_SIZE * THREADS);
+  void* packed[THREADS];
+  for (size_t t = 0; t < THREADS; t++)
+  {
+    packed[t] = pointer_offset(block, t * OBJECT_SIZE);
+    new (packed[t]) std::atomic<size_t>(0);
+  }
+
+  DO_TIME("Objects in address order", { run(packed); });
+  DO_TIME("Objects spread over cache lines", { run(spread); });
+
+  for (auto p : objects)
+    a->dealloc(p);
+  a->dealloc(block);
+  pool->release(a);
+  return 0;
+}
@@ -2,6 +2,7 @@
 #include <test/measuretime.h>
 #include <test/setup.h>
 #include <unordered_set>
+#include <vector>
 
 using namespace snmalloc;
 
@@ -62,6 +63,40 @@ void test_alloc_dealloc(size_t count, size_t size, bool write)
   current_alloc_pool()->debug_check_empty();
 }
 
+/**
+ * Allocate and free objects whose sizes vary from one to the next, up to
+ * `max_size`, so that each call maps a size to a sizeclass.
+ */
+void test_dynamic_sizes(size_t count, size_t max_size)
+{
+  auto* alloc = ThreadAlloc::get();
+  std::vector<size_t> sizes(count);
+  std::vector<void*> objects(count);
+
+  size_t state = 1;
+  for (auto& size : sizes)
+  {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    size = ((state >> 33) % max_size) + 1;
+  }
+
+  DO_TIME(
+    "Count: " << std::setw(6) << count << ", Dynamic sizes up to: "
+              << std::setw(6) << max_size,
+    {
+      for (size_t round = 0; round < 16; round++)
+      {
+        for (size_t i = 0; i < count; i++)
+          objects[i] = alloc->alloc(sizes[i]);
+
+        for (size_t i = 0; i < count; i++)
+          alloc->dealloc(objects[i], sizes[i]);
+      }
+    });
+
+  current_alloc_pool()->debug_check_empty();
+}
+
 int main(int, char**)
 {
   setup();
@@ -82,5 +117,8 @@ int main(int, char**)
     test_alloc_dealloc<YesZero>(1 << 10, size, true);
   }
 
+  for (size_t max_size = 1 << 10; max_size <= 1 << 16; max_size <<= 2)
+    test_dynamic_sizes(1 << 12, max_size);
+
   return 0;
 }
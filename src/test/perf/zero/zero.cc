@@ -0,0 +1,145 @@
+/**
+ * Compares ways of zeroing ranges of the sizes used for medium and large
+ * objects, to choose the thresholds at which `PAL::zero` switches between
+ * them.
+ *
+ * Dirty ranges are zeroed and then have one word in each page written, as
+ * a newly allocated object would, so that the cost of faulting pages back
+ * in after `madvise` is included.  Fresh ranges, never touched before, are
+ * zeroed and then have only their first page written, as a `calloc`
+ * served from a new chunk that is used sparsely would; for these the
+ * memory committed by zeroing is also reported.
+ */
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <snmalloc.h>
+#include <string.h>
+#include <test/setup.h>
+
+#if defined(__linux__)
+#  include <sys/mman.h>
+#endif
+
+using namespace snmalloc;
+
+// Larger than the last level cache, so that ranges are zeroed cold, as
+// they are when a medium object is reused some time after being freed.
+static constexpr size_t BUFFER_SIZE = 256 * 1024 * 1024;
+
+#ifdef NDEBUG
+static constexpr size_t BYTES_PER_SIZE = BUFFER_SIZE;
+static constexpr size_t MAX_SIZE = 16 * 1024 * 1024;
+#else
+static constexpr size_t BYTES_PER_SIZE = BUFFER_SIZE / 16;
+static constexpr size_t MAX_SIZE = 1024 * 1024;
+#endif
+
+/**
+ * Pages of the process that are resident, from `/proc/self/statm`.
+ */
+static size_t resident_pages()
+{
+  size_t size = 0;
+  size_t resident = 0;
+  FILE* f = fopen("/proc/self/statm", "r");
+  if (f != nullptr)
+  {
+    if (fscanf(f, "%zu %zu", &size, &resident) != 2)
+      resident = 0;
+    fclose(f);
+  }
+  return resident;
+}
+
+template<typename F>
+NOINLINE double time_zero(char* buffer, size_t size, F zero, bool touch_all)
+{
+  size_t count = BYTES_PER_SIZE / size;
+  auto start = std::chrono::high_resolution_clock::now();
+  size_t offset = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    char* p = buffer + offset;
+    zero(p, size);
+    size_t touched = touch_all ? size : OS_PAGE_SIZE;
+    for (size_t j = 0; j < touched; j += OS_PAGE_SIZE)
+      *reinterpret_cast<volatile size_t*>(p + j) = j;
+
+    offset += size;
+    if (offset + size > BUFFER_SIZE)
+      offset = 0;
+  }
+  auto finish = std::chrono::high_resolution_clock::now();
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(finish - start)
+              .count();
+  return static_cast<double>(ns) / static_cast<double>(count);
+}
+
+/**
+ * Time `zero` on fresh ranges of `size` bytes, with only their first page
+ * used afterwards, and report the time and the memory committed per range.
+ */
+template<typename F>
+static void fresh(char* buffer, size_t size, const char* name, F zero)
+{
+#if defined(__linux__)
+  madvise(buffer, BUFFER_SIZE, MADV_DONTNEED);
+#endif
+  size_t before = resident_pages();
+  double ns = time_zero(buffer, size, zero, false);
+  size_t ranges = bits::min(BYTES_PER_SIZE, BUFFER_SIZE) / size;
+  size_t committed = (resident_pages() - before) * OS_PAGE_SIZE / ranges;
+  std::cout << ", " << name << " " << ns << " ns " << committed << " B";
+}
+
+int main(int, char**)
+{
+  setup();
+
+  auto* buffer = static_cast<char*>(Pal::reserve_at_least(BUFFER_SIZE).first);
+  memset(buffer, 1, BUFFER_SIZE);
+
+  std::cout << "Dirty ranges" << std::endl;
+  std::cout << "size, memset, streaming, madvise (ns per range)" << std::endl;
+  for (size_t size = 16 * 1024; size <= MAX_SIZE; size <<= 1)
+  {
+    double by_memset = time_zero(
+      buffer, size, [](char* p, size_t n) { memset(p, 0, n); }, true);
+    double by_streaming = time_zero(
+      buffer, size, [](char* p, size_t n) { Aal::zero_streaming(p, n); }, true);
+    double by_madvise = 0;
+#if defined(__linux__)
+    by_madvise = time_zero(
+      buffer,
+      size,
+      [](char* p, size_t n) { madvise(p, n, MADV_DONTNEED); },
+      true);
+#endif
+    double by_pal = time_zero(
+      buffer, size, [](char* p, size_t n) { Pal::zero(p, n); }, true);
+    std::cout << size << ", " << by_memset << ", " << by_streaming << ", "
+              << by_madvise << ", pal " << by_pal << std::endl;
+  }
+
+  std::cout << std::endl
+            << "Fresh ranges, first page used (per range)" << std::endl;
+  for (size_t size = 16 * 1024; size <= MAX_SIZE; size <<= 1)
+  {
+    std::cout << size;
+    fresh(buffer, size, "streaming", [](char* p, size_t n) {
+      Aal::zero_streaming(p, n);
+    });
+#if defined(__linux__)
+    fresh(buffer, size, "madvise", [](char* p, size_t n) {
+      madvise(p, n, MADV_DONTNEED);
+    });
+#endif
+    fresh(buffer, size, "pal page aligned", [](char* p, size_t n) {
+      Pal::zero<true>(p, n);
+    });
+    std::cout << std::endl;
+  }
+
+  return 0;
+}